@@ -3,7 +3,6 @@
 #include <fstream>
 #include <vector>
 #include <glad/glad.h>
-#include <GLFW/glfw3.h>
 
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
@@ -11,6 +10,26 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include<bits/stdc++.h>
 
+#include "ecs.h"
+#include "gamestate.h"
+#include "geometry.h"
+#include "gltrace.h"
+#include "instrument.h"
+#include "jobs.h"
+#include "level.h"
+#include "pacer.h"
+#include "platform.h"
+#include "renderer.h"
+#include "rewind.h"
+#include "shadercache.h"
+#include "simulate.h"
+#include "spawn.h"
+#include "sprites.h"
+#include "telemetry.h"
+#ifdef EMBED_SHADERS
+#include "shaders.h"	// generated by the Makefile from *.vert / *.frag
+#endif
+
 using namespace std;
 
 struct VAO {
@@ -21,9 +40,158 @@ struct VAO {
 	GLenum PrimitiveMode;
 	GLenum FillMode;
 	int NumVertices;
+
+	~VAO();
 };
 typedef struct VAO VAO;
 
+/* Registry that owns every VAO, VBO and program the game creates */
+enum GLResourceKind { RES_VAO, RES_VBO, RES_PROGRAM, RES_TEXTURE, RES_FRAMEBUFFER, RES_KINDS };
+static const char *GLResourceName[RES_KINDS] = { "VAO", "VBO", "program", "texture", "framebuffer" };
+
+struct GLResources {
+	vector< unique_ptr<VAO> > vaos;
+	vector<GLuint> programs;
+	// Objects not owned by a VAO struct, e.g. the sprite renderer's
+	vector<GLuint> arrays, buffers, textures, framebuffers;
+	vector<long> buffer_bytes, texture_bytes;
+	long live[RES_KINDS];
+	long bytes[RES_KINDS];
+	long created[RES_KINDS];
+
+	GLResources() {
+		for (int k=0; k<RES_KINDS; k++)
+			live[k] = bytes[k] = created[k] = 0;
+	}
+	~GLResources() {
+		// Objects still here were never released with a live context
+		report("exit");
+		vaos.clear();
+	}
+
+	void track (GLResourceKind kind, int count, long size) {
+		live[kind] += count;
+		created[kind] += count;
+		bytes[kind] += size;
+	}
+	void untrack (GLResourceKind kind, int count, long size) {
+		live[kind] -= count;
+		bytes[kind] -= size;
+	}
+
+	VAO* adopt (VAO *vao) {
+		vaos.push_back(unique_ptr<VAO>(vao));
+		return vao;
+	}
+	void destroy (VAO *vao) {
+		for (size_t i=0; i<vaos.size(); i++)
+			if (vaos[i].get() == vao) {
+				vaos[i].swap(vaos.back());
+				vaos.pop_back();
+				return;
+			}
+	}
+	GLuint adoptProgram (GLuint program) {
+		programs.push_back(program);
+		track(RES_PROGRAM, 1, 0);
+		return program;
+	}
+
+	GLuint adoptVertexArray (GLuint vao) {
+		arrays.push_back(vao);
+		track(RES_VAO, 1, 0);
+		return vao;
+	}
+	GLuint adoptBuffer (GLuint vbo, long size) {
+		buffers.push_back(vbo);
+		buffer_bytes.push_back(size);
+		track(RES_VBO, 1, size);
+		return vbo;
+	}
+	/* A buffer adopted above was reallocated to 'size' bytes */
+	void resizeBuffer (GLuint vbo, long size) {
+		for (size_t i=0; i<buffers.size(); i++)
+			if (buffers[i] == vbo) {
+				bytes[RES_VBO] += size - buffer_bytes[i];
+				buffer_bytes[i] = size;
+			}
+	}
+	GLuint adoptTexture (GLuint texture, long size) {
+		textures.push_back(texture);
+		texture_bytes.push_back(size);
+		track(RES_TEXTURE, 1, size);
+		return texture;
+	}
+	void resizeTexture (GLuint texture, long size) {
+		for (size_t i=0; i<textures.size(); i++)
+			if (textures[i] == texture) {
+				bytes[RES_TEXTURE] += size - texture_bytes[i];
+				texture_bytes[i] = size;
+			}
+	}
+	GLuint adoptFramebuffer (GLuint framebuffer) {
+		framebuffers.push_back(framebuffer);
+		track(RES_FRAMEBUFFER, 1, 0);
+		return framebuffer;
+	}
+
+	/* Free everything; must run while the GL context is still current */
+	void release () {
+		vaos.clear();
+		for (size_t i=0; i<arrays.size(); i++) {
+			glDeleteVertexArrays(1, &arrays[i]);
+			untrack(RES_VAO, 1, 0);
+		}
+		for (size_t i=0; i<buffers.size(); i++) {
+			glDeleteBuffers(1, &buffers[i]);
+			untrack(RES_VBO, 1, buffer_bytes[i]);
+		}
+		for (size_t i=0; i<textures.size(); i++) {
+			glDeleteTextures(1, &textures[i]);
+			untrack(RES_TEXTURE, 1, texture_bytes[i]);
+		}
+		for (size_t i=0; i<framebuffers.size(); i++) {
+			glDeleteFramebuffers(1, &framebuffers[i]);
+			untrack(RES_FRAMEBUFFER, 1, 0);
+		}
+		arrays.clear();
+		buffers.clear();
+		buffer_bytes.clear();
+		textures.clear();
+		texture_bytes.clear();
+		framebuffers.clear();
+		for (size_t i=0; i<programs.size(); i++) {
+			glDeleteProgram(programs[i]);
+			untrack(RES_PROGRAM, 1, 0);
+		}
+		programs.clear();
+	}
+
+	void report (const char *when) {
+#ifndef NDEBUG
+		for (int k=0; k<RES_KINDS; k++)
+			if (live[k] != 0)
+				fprintf(stderr, "GL leak at %s: %ld %s(s) still live, %ld bytes (%ld created)\n",
+						when, live[k], GLResourceName[k], bytes[k], created[k]);
+#endif
+	}
+} Resources;
+
+/* The window system backend, chosen in main (see platform.h) */
+Platform *Window;
+
+VAO::~VAO()
+{
+	// Deleting without a context is undefined, the driver reclaims on teardown anyway
+	if (Window && Window->current()) {
+		glDeleteBuffers (1, &VertexBuffer);
+		glDeleteBuffers (1, &ColorBuffer);
+		glDeleteVertexArrays (1, &VertexArrayID);
+	}
+	Resources.untrack(RES_VAO, 1, 0);
+	Resources.untrack(RES_VBO, 2, 2*3*NumVertices*sizeof(GLfloat));
+}
+
 struct GLMatrices {
 	glm::mat4 projection;
 	glm::mat4 model;
@@ -31,70 +199,77 @@ struct GLMatrices {
 	GLuint MatrixID;
 } Matrices;
 
+/* draw() and the helpers below only record GL calls; the render thread
+   replays them (see renderer.h) */
+RenderThread Renderer;
+
+CommandBuffer& commands ()
+{
+	return *Renderer.recording;
+}
+
+/* Worker threads for the simulation kernels, started in main */
+JobSystem Jobs;
+
 GLuint programID;
 void draw1(int i);
-/* Function to load Shaders - Use it as it is */
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
+/* Print a shader or program info log, but only when the driver had something to say */
+static void printInfoLog (const char *what, const char *name, const vector<char> &log)
+{
+	if (log.size() > 1 && log[0] != '\0')
+		fprintf(stderr, "%s %s:\n%s\n", what, name, &log[0]);
+}
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+/* Compile and link GLSL sources, or reload the binary cached for them at
+   <name>.progbin when the driver supports program binaries */
+GLuint LoadProgram(const char * vertex_source, const char * fragment_source, const char * name) {
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open())
-	{
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
-	}
+	string cache_path = string(name) + ".progbin";
+	double start = instrumentNow();
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
+	GLuint ProgramID = shaderCacheLoad(cache_path.c_str(), vertex_source, fragment_source);
+	if (ProgramID) {
+		instrumentPhase("shader binary load", instrumentNow() - start);
+		instrumentNote("shader cache: hit for %s", name);
+		return Resources.adoptProgram(ProgramID);
 	}
 
+	// Create the shaders
+	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
+	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+
 	GLint Result = GL_FALSE;
 	int InfoLogLength;
 
 	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
+	glShaderSource(VertexShaderID, 1, &vertex_source , NULL);
 	glCompileShader(VertexShaderID);
 
 	// Check Vertex Shader
 	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
 	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> VertexShaderErrorMessage(InfoLogLength);
+	std::vector<char> VertexShaderErrorMessage( max(InfoLogLength, int(1)) );
 	glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &VertexShaderErrorMessage[0]);
+	printInfoLog("vertex shader", name, VertexShaderErrorMessage);
 
 	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
+	glShaderSource(FragmentShaderID, 1, &fragment_source , NULL);
 	glCompileShader(FragmentShaderID);
 
 	// Check Fragment Shader
 	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
 	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
+	std::vector<char> FragmentShaderErrorMessage( max(InfoLogLength, int(1)) );
 	glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &FragmentShaderErrorMessage[0]);
+	printInfoLog("fragment shader", name, FragmentShaderErrorMessage);
 
 	// Link the program
-	fprintf(stdout, "Linking program\n");
-	GLuint ProgramID = glCreateProgram();
+	ProgramID = glCreateProgram();
 	glAttachShader(ProgramID, VertexShaderID);
 	glAttachShader(ProgramID, FragmentShaderID);
+	bool cacheable = shaderCacheSupported();
+	if (cacheable)
+		glProgramParameteri(ProgramID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 	glLinkProgram(ProgramID);
 
 	// Check the program
@@ -102,24 +277,97 @@ GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path
 	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
 	std::vector<char> ProgramErrorMessage( max(InfoLogLength, int(1)) );
 	glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-	fprintf(stdout, "%s\n", &ProgramErrorMessage[0]);
+	printInfoLog("program", name, ProgramErrorMessage);
 
 	glDeleteShader(VertexShaderID);
 	glDeleteShader(FragmentShaderID);
+	instrumentPhase("shader compile+link", instrumentNow() - start);
+
+	if (cacheable && Result == GL_TRUE) {
+		shaderCacheStore(cache_path.c_str(), ProgramID, vertex_source, fragment_source);
+		instrumentNote("shader cache: miss for %s, binary stored", name);
+	}
+	else
+		instrumentNote("shader cache: unavailable for %s", name);
 
-	return ProgramID;
+	return Resources.adoptProgram(ProgramID);
 }
 
-static void error_callback(int error, const char* description)
-{
-	fprintf(stderr, "Error: %s\n", description);
+/* Function to load Shaders from files - prefer the sources embedded by the Makefile */
+GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
+
+	double start = instrumentNow();
+
+	// Read the Vertex Shader code from the file
+	std::string VertexShaderCode;
+	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
+	if(VertexShaderStream.is_open())
+	{
+		std::string Line = "";
+		while(getline(VertexShaderStream, Line))
+			VertexShaderCode += "\n" + Line;
+		VertexShaderStream.close();
+	}
+
+	// Read the Fragment Shader code from the file
+	std::string FragmentShaderCode;
+	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
+	if(FragmentShaderStream.is_open()){
+		std::string Line = "";
+		while(getline(FragmentShaderStream, Line))
+			FragmentShaderCode += "\n" + Line;
+		FragmentShaderStream.close();
+	}
+	instrumentPhase("shader read", instrumentNow() - start);
+
+	// Sample_GL.vert -> Sample_GL
+	string name = vertex_file_path;
+	name = name.substr(0, name.rfind('.'));
+	return LoadProgram(VertexShaderCode.c_str(), FragmentShaderCode.c_str(), name.c_str());
 }
 
-void quit(GLFWwindow *window)
+extern long frames_drawn, idle_waits;
+extern long cull_drawn, cull_culled;
+extern FramePacer Pacer;
+extern long snapshots;
+extern size_t snapshot_bytes, snapshot_bytes_max;
+extern double snapshot_time;
+extern RewindBuffer History;
+extern TelemetryStream Telemetry;
+extern GameStates States;
+extern BrickSpawner Spawner;
+extern int peak_bricks, peak_lasers;
+
+void quit()
 {
-	glfwDestroyWindow(window);
-	glfwTerminate();
-	//    exit(EXIT_SUCCESS);
+	// Take the context back from the render thread
+	Renderer.stop();
+	if (Telemetry.active()) {
+		Telemetry.close();
+		instrumentNote("telemetry: %ld batches sent, %ld lost", Telemetry.batchesSent(), Telemetry.batchesLost());
+	}
+	if (Renderer.capture)
+		fclose(Renderer.capture);
+	// GPU objects go first, while the context they belong to still exists
+	Resources.release();
+	Resources.report("quit");
+	instrumentNote("frames: %ld drawn, %ld idle waits", frames_drawn, idle_waits);
+	Pacer.report();
+	if (frames_drawn)
+		instrumentNote("culling: %.1f drawn, %.1f off screen per frame",
+				cull_drawn/(double)frames_drawn, cull_culled/(double)frames_drawn);
+	glTraceReport();
+	States.report();
+	instrumentNote("entities: %llu bricks spawned in the last game, at most %d bricks and %d lasers in play",
+			(unsigned long long)Spawner.spawned, peak_bricks, peak_lasers);
+	if (snapshots)
+		instrumentNote("rewind: %ld snapshots, %.2f us each, %zu bytes each (%zu at most), %.1fs of history in %zu bytes",
+				snapshots, snapshot_time*1e6/snapshots, snapshot_bytes/snapshots, snapshot_bytes_max,
+				History.span(), History.bytesUsed());
+	instrumentReport(stdout);
+	levelUnmapAll();
+	Window->close();
+	exit(EXIT_SUCCESS);
 }
 
 
@@ -160,43 +408,39 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
 			(void*)0            // array buffer offset
 			);
 
-	return vao;
+	Resources.track(RES_VAO, 1, 0);
+	Resources.track(RES_VBO, 2, 2*3*numVertices*sizeof(GLfloat));
+	return Resources.adopt(vao);
 }
 
 /* Generate VAO, VBOs and return VAO handle - Common Color for all vertices */
 struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloat* vertex_buffer_data, const GLfloat red, const GLfloat green, const GLfloat blue, GLenum fill_mode=GL_FILL)
 {
-	GLfloat* color_buffer_data = new GLfloat [3*numVertices];
+	vector<GLfloat> color_buffer_data (3*numVertices);
 	for (int i=0; i<numVertices; i++) {
 		color_buffer_data [3*i] = red;
 		color_buffer_data [3*i + 1] = green;
 		color_buffer_data [3*i + 2] = blue;
 	}
 
-	return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
+	return create3DObject(primitive_mode, numVertices, vertex_buffer_data, &color_buffer_data[0], fill_mode);
 }
 
-/* Render the VBOs handled by VAO */
-void draw3DObject (struct VAO* vao)
+/* Release a VAO and its VBOs before teardown */
+void delete3DObject (struct VAO* vao)
 {
-	// Change the Fill Mode for this object
-	glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
-
-	// Bind the VAO to use
-	glBindVertexArray (vao->VertexArrayID);
-
-	// Enable Vertex Attribute 0 - 3d Vertices
-	glEnableVertexAttribArray(0);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->VertexBuffer);
+	Resources.destroy(vao);
+}
 
-	// Enable Vertex Attribute 1 - Color
-	glEnableVertexAttribArray(1);
-	// Bind the VBO to use
-	glBindBuffer(GL_ARRAY_BUFFER, vao->ColorBuffer);
+/* Render the VBOs handled by VAO */
+long draw_calls=0;
 
-	// Draw the geometry !
-	glDrawArrays(vao->PrimitiveMode, 0, vao->NumVertices); // Starting from vertex 0; 3 vertices total -> 1 triangle
+void draw3DObject (struct VAO* vao)
+{
+	draw_calls++;
+	// Fill mode, VAO, both VBOs and the draw in one record
+	commands().drawObject(vao->VertexArrayID, vao->VertexBuffer, vao->ColorBuffer,
+			vao->FillMode, vao->PrimitiveMode, vao->NumVertices);
 }
 
 /**************************
@@ -208,19 +452,28 @@ float triangle_rot_dir = 1;
 float rectangle_rot_dir = 1;
 bool triangle_rot_status = true;
 bool rectangle_rot_status = true;
-float position1 = 0;
-float position2 = 0;
-float position3 = 0;
-float position4 = 0;
-float position6[10000]={0};
-float position7[10000]={0};
+/* Everything that moves is an entity (see ecs.h). Bricks and lasers are
+   added as the game runs; the baskets and the cannon are Players, and
+   their transforms hold offsets from the level's rest positions under
+   the names the input code has always used. */
+World Entities;
+Archetype &Bricks=Entities.archetype(TRANSFORM|COLOR|LIFETIME);
+Archetype &Lasers=Entities.archetype(TRANSFORM|VELOCITY|COLLIDER|LIFETIME);
+Archetype &Players=Entities.archetype(TRANSFORM);
+const int RED_BASKET=Players.add(), GREEN_BASKET=Players.add(), CANNON=Players.add();
+float &position1=Players.f(FIELD_X, RED_BASKET);
+float &position2=Players.f(FIELD_X, GREEN_BASKET);
+float &position3=Players.f(FIELD_Y, CANNON);
+float &position4=Players.f(FIELD_ANGLE, CANNON);
+
+/* Where new bricks come from; SAMPLE2D_SEED fixes the seed */
+BrickSpawner Spawner;
 float xpos=0;
 float ypos=0;
 float zoom=1;
 float ctrl=0;
 float alt=0;
 
-int press=-1;
 float camera_rotation_angle = 90;
 float rectangle_rotation = 0;
 float triangle_rotation = 0;
@@ -228,80 +481,163 @@ float cirlce_rotation = 70;
 float cirlce_rotation1 = 70;
 float rectangle_rotation1 = 0;
 int flag=0;
-float pos[10000]={0};
 int score=0;
-int vis[10000]={0};
 int k=0;
-float position5[10000]={0};
 int q=-1;
-vector<float>quex;
-vector<float>quey;
-vector<int>quei;
-float laserx[10000],lasery[10000];
-float laserx1[10000],lasery1[10000];
 int score2;
 int dig=-1;
-int ex=0,exred=0,exgreen=0;
-int j=-1;
-int random2[10000];
-float posx[10000]={0};
+int exred=0,exgreen=0;
+int caught=0;	// bricks scored in a basket, for telemetry
 int score1;
 float reltime,curtime;
 int lb=0,rb=0,gg=0;
 int flag2=0,flag3=0;
 int flag4=0;
-float xcollide[10000],ycollide[10000];
 int lmouse=0,rmouse=0;
 int leftmove=0,rightmove=0,movepan=0,moverifle=0,movebullet=0;
 float speed=1;
-double last_update=glfwGetTime();
-float u_time1[10000]={0};
-float u_time2[10000]={0};
+double last_update=instrumentNow();
 double utime3=0;
-int flagp=0;
+double brick_fall_time=0,laser_step_time=0;
+BrickEvents Events;
+vector<LaserHit> Hits;
+GameStates States(STATE_MENU);
+
+/* Event-driven redraw: callbacks mark the frame dirty, and while nothing is
+   animating the main loop sleeps in Window->waitEvents() until they do */
+bool frame_dirty=true;
+long frames_drawn=0, idle_waits=0;
+FramePacer Pacer;
+
+void invalidate(){
+	frame_dirty=true;
+}
+
+/* Anything but playing, with no button held: the picture cannot change */
+bool simulationIdle(){
+	return States.state!=STATE_PLAYING && !lmouse && !rmouse;
+}
+
+/* Active playfield description and every level available to switch to */
+const LevelData *Level;
+vector<const LevelData*> Levels;
+
+/* SAMPLE2D_TELEMETRY=unix:PATH|FILE streams game state (see telemetry.h) */
+TelemetryStream Telemetry;
+const double TELEMETRY_INTERVAL = 0.5;
+
+/* Hand this frame's counters to the telemetry writer; never waits on it */
+void sendTelemetry (double frame_seconds)
+{
+	TelemetryFrame f;
+	f.time=instrumentNow();
+	f.frame_ms=frame_seconds*1e3;
+	f.score=score;
+	f.level=find(Levels.begin(), Levels.end(), Level)-Levels.begin();
+	f.caught=caught;
+	f.missed_red=exred;
+	f.missed_green=exgreen;
+	f.lasers=Lasers.count;
+	Telemetry.frame(f);
+}
+
+/* Rewind: the live part of the game state is packed into a flat snapshot
+   every frame and kept as deltas in a bounded ring, so R can step back
+   REWIND_SECONDS without replaying anything */
+#pragma pack(push, 1)
+struct GameStateHeader {
+	float speed;
+	int32_t score, k, over, exred, exgreen;
+	uint64_t spawned;	// the spawn stream's position, not Bricks.count: bricks are removed as they leave play
+};
+#pragma pack(pop)
+
+const double REWIND_SECONDS=5;
+RewindBuffer History(8<<20, 16384);
+vector<uint8_t> Snapshot;
+double snapshot_time=0;
+long snapshots=0;
+// State sizes, so a snapshot that grows with the length of a game shows in the report
+size_t snapshot_bytes=0, snapshot_bytes_max=0;
+
+/* The header, then every archetype's columns */
+void saveState (vector<uint8_t> &out)
+{
+	out.resize(sizeof(GameStateHeader));
+	GameStateHeader *h=(GameStateHeader*)&out[0];
+	h->speed=speed; h->score=score; h->k=k;
+	h->over=States.state==STATE_GAMEOVER; h->exred=exred; h->exgreen=exgreen;
+	h->spawned=Spawner.spawned;
+	Entities.save(out);
+}
+
+void loadState (const vector<uint8_t> &in)
+{
+	const GameStateHeader *h=(const GameStateHeader*)&in[0];
+	speed=h->speed; score=h->score; k=h->k;
+	exred=h->exred; exgreen=h->exgreen;
+	Spawner.seek(h->spawned);
+	// pausing is not game state: only leave or enter the game-over screen
+	if(h->over)
+		States.set(STATE_GAMEOVER);
+	else if(States.state==STATE_GAMEOVER)
+		States.set(STATE_PLAYING);
+	Entities.load(&in[sizeof(GameStateHeader)]);
+}
+
+/* Called once per simulated frame */
+void recordState ()
+{
+	double start=instrumentNow();
+	saveState(Snapshot);
+	History.record(Snapshot, instrumentNow());
+	snapshot_time+=instrumentNow()-start;
+	snapshots++;
+	snapshot_bytes+=Snapshot.size();
+	snapshot_bytes_max=max(snapshot_bytes_max,Snapshot.size());
+}
+
+void rewindState ()
+{
+	double start=instrumentNow();
+	if(History.rewind(instrumentNow()-REWIND_SECONDS, Snapshot))
+		loadState(Snapshot);
+	instrumentNote("rewind: %.1f us", (instrumentNow()-start)*1e6);
+}
+
 void initvar(){
 	
-	quex.clear();
-	quey.clear();
-	quei.clear();
-
 	position1 = 0;
 	position2 = 0;
 	position3 = 0;
 	position4 = 0;
-	for(int i=0;i<10000;i++){
-		position6[i]=0;
-		position7[i]=0;
-			pos[i]=0;
-		position5[i]=0;
-		vis[i]=0;
-		xcollide[i]=0;
-		ycollide[i]=0;
-		u_time1[i]=0;
-		u_time2[i]=0;
-	}
+	Bricks.clear();
+	Lasers.clear();
+	Spawner.restart();
 	xpos=0;
 	ypos=0;
 	zoom=1;
 
-	press=-1;
 	flag=0;
 	score=0;
 	k=0;
 	q=-1;
 	dig=-1;
 	exred=0,exgreen=0;
-	j=-1;
+	caught=0;
 	flag2=0,flag3=0;
 	flag4=0;
 	speed=1;
-	last_update=glfwGetTime();
-	flagp=0;
+	last_update=instrumentNow();
+	brick_fall_time=0;
+	laser_step_time=0;
+	History.clear();
 
 }
 
-void mousezoom(GLFWwindow* window, double xoffset, double yoffset)
+void mousezoom(double yoffset)
 {
+	invalidate();
 	if (yoffset==-1) { 
 		zoom /= 1.1; 
 	}
@@ -339,138 +675,174 @@ void pan(){
 
 }
 
-void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
+/* Launch a laser from the barrel along its current tilt; its direction is
+   kept as a unit vector so nothing in flight needs trig */
+void fireLaser ()
+{
+	int i=Lasers.add();
+	flag3=1;
+	Lasers.f(FIELD_DX,i)=cos(position4*M_PI/180.0f);
+	Lasers.f(FIELD_DY,i)=sin(position4*M_PI/180.0f);
+	Lasers.f(FIELD_X,i)=Level->cannon.x;
+	Lasers.f(FIELD_Y,i)=Level->cannon.y-0.1+position3;
+}
+
+/* Drop bricks that were caught, missed or shot, and lasers that hit a brick
+   or whose tail has left the field ([-8,8] x [-4,4], see pan()): moving
+   outward in a straight line, they never come back. remove() moves the last
+   entity into the hole, so both walks run from the end. */
+int peak_bricks=0, peak_lasers=0;
+
+void removeGone ()
+{
+	for(int i=Bricks.count-1;i>=0;i--)
+		if(Bricks.i(FIELD_GONE,i))
+			Bricks.remove(i);
+	for(int i=Lasers.count-1;i>=0;i--){
+		float x=Lasers.f(FIELD_X0,i), y=Lasers.f(FIELD_Y0,i);
+		if(Lasers.i(FIELD_GONE,i) || x<-8 || x>8 || y<-4 || y>4)
+			Lasers.remove(i);
+	}
+	peak_bricks=max(peak_bricks,Bricks.count);
+	peak_lasers=max(peak_lasers,Lasers.count);
+}
+
+void keyboard (int key, int action)
 {
-	// Function is called first on GLFW_PRESS.
+	invalidate();
+	// Function is called first on ACTION_PRESS.
 
-	if (action == GLFW_RELEASE) {
+	if (action == ACTION_RELEASE) {
 		switch (key) {
-			case GLFW_KEY_C:
+			case 'C':
 				rectangle_rot_status = !rectangle_rot_status;
 				break;
-			case GLFW_KEY_P:
+			case 'P':
 				triangle_rot_status = !triangle_rot_status;
 				break;
-			case GLFW_KEY_RIGHT_CONTROL:
+			case KEY_RIGHT_CONTROL:
 				ctrl=0;
 				break;
-			case GLFW_KEY_RIGHT_ALT:
+			case KEY_RIGHT_ALT:
 				alt=0;
 				break;
-			case GLFW_KEY_LEFT_CONTROL:
+			case KEY_LEFT_CONTROL:
 				ctrl=0;
 				break;
-			case GLFW_KEY_LEFT_ALT:
+			case KEY_LEFT_ALT:
 				alt=0;
 				break;
 			default:
 				break;
 		}
-		if(key==GLFW_KEY_RIGHT || key==GLFW_KEY_LEFT){
+		if(key==KEY_RIGHT || key==KEY_LEFT){
 			lb=0;
 			rb=0;
 		}
-		if(key==GLFW_KEY_S || key==GLFW_KEY_F)
+		if(key=='S' || key=='F')
 			gg=0;
-		if(key==GLFW_KEY_SPACE)
+		if(key==KEY_SPACE)
 			flag2=0;
 
 
 	}
-	else if (action == GLFW_PRESS) {
+	else if (action == ACTION_PRESS) {
 		switch (key) {
-			case GLFW_KEY_ESCAPE:
-				quit(window);
+			case KEY_ESCAPE:
+				quit();
 				break;
 
 			default:
 				break;
 		}
-		double current_time = glfwGetTime();
-		if(key == GLFW_KEY_SPACE && (current_time-last_update) > 0.5){
-			last_update = current_time;
-			press++;
-			flag3=1;
-			position6[press]=position4;
-			position7[press]=position3;
-			//flag4=0;
-			xcollide[press]=-7.6;
-			ycollide[press]=0.55;
+		double current_time = instrumentNow();
+		if(States.runs(SYSTEM_CONTROL)){
+			if(key == KEY_SPACE && (current_time-last_update) > 0.5){
+				last_update = current_time;
+				fireLaser();
+				//flag4=0;
+			}
 		}
-		if(key==GLFW_KEY_RIGHT_CONTROL || key==GLFW_KEY_LEFT_CONTROL)
+		if(key==KEY_RIGHT_CONTROL || key==KEY_LEFT_CONTROL)
 			ctrl=1;
-		if(key == GLFW_KEY_RIGHT_ALT || key == GLFW_KEY_LEFT_ALT)
+		if(key == KEY_RIGHT_ALT || key == KEY_LEFT_ALT)
 			alt=1;	
-		if(ctrl==1 && key == GLFW_KEY_LEFT  && current_time-utime3>0.05){
-			position1-=0.2;
-			lb=-1;
-			utime3=glfwGetTime();
-		}
+		if(States.runs(SYSTEM_CONTROL)){
+			if(ctrl==1 && key == KEY_LEFT  && current_time-utime3>0.05){
+				position1-=0.2;
+				lb=-1;
+				utime3=instrumentNow();
+			}
 
 
 
-		if(ctrl==1 && key == GLFW_KEY_RIGHT && current_time-utime3>0.05){
-			position1+=0.2;
-			lb=1;
-			utime3=glfwGetTime();
-		}
-		if(alt==1 && key == GLFW_KEY_LEFT && current_time-utime3>0.05){
-			position2-=0.2;
-			rb=-1;
-			utime3=glfwGetTime();
-		}
-		if(alt==1 && key == GLFW_KEY_RIGHT && current_time-utime3>0.05){
-			rb=1;
-			position2+=0.2;
-			utime3=glfwGetTime();
-		}
-		if(key == GLFW_KEY_S && current_time-utime3>0.05){
-			position3-=0.2;
-			gg=-1;
-			utime3=glfwGetTime();
-		}
-		if(key== GLFW_KEY_F && current_time-utime3>0.05){
-			position3+=0.2;
-			gg=1;
-			utime3=glfwGetTime();
-		}
-		if(key==GLFW_KEY_A && current_time-utime3>0.05){
-			position4-=10;
-			utime3=glfwGetTime();
-		}
-		if(key==GLFW_KEY_D && current_time-utime3>0.05){
-			position4+=10;
-			utime3=glfwGetTime();
+			if(ctrl==1 && key == KEY_RIGHT && current_time-utime3>0.05){
+				position1+=0.2;
+				lb=1;
+				utime3=instrumentNow();
+			}
+			if(alt==1 && key == KEY_LEFT && current_time-utime3>0.05){
+				position2-=0.2;
+				rb=-1;
+				utime3=instrumentNow();
+			}
+			if(alt==1 && key == KEY_RIGHT && current_time-utime3>0.05){
+				rb=1;
+				position2+=0.2;
+				utime3=instrumentNow();
+			}
+			if(key == 'S' && current_time-utime3>0.05){
+				position3-=0.2;
+				gg=-1;
+				utime3=instrumentNow();
+			}
+			if(key== 'F' && current_time-utime3>0.05){
+				position3+=0.2;
+				gg=1;
+				utime3=instrumentNow();
+			}
+			if(key=='A' && current_time-utime3>0.05){
+				position4-=10;
+				utime3=instrumentNow();
+			}
+			if(key=='D' && current_time-utime3>0.05){
+				position4+=10;
+				utime3=instrumentNow();
+			}
 		}
-		if(key==GLFW_KEY_UP)
-			mousezoom(window,0,+1);
-		if(key==GLFW_KEY_DOWN)
-			mousezoom(window,0,-1);
-		if(key==GLFW_KEY_RIGHT){
+		if(key==KEY_UP)
+			mousezoom(+1);
+		if(key==KEY_DOWN)
+			mousezoom(-1);
+		if(key==KEY_RIGHT){
 			xpos+=0.2;
 			pan();
 		}
-		if(key==GLFW_KEY_LEFT){
+		if(key==KEY_LEFT){
 			xpos-=0.2;
 			pan();
 		}
-		if(key==GLFW_KEY_Z){
+		if(key=='Z'){
 			ypos+=0.2;
 			pan();
 		}
-		if(key==GLFW_KEY_X){
+		if(key=='X'){
 			ypos-=0.2;
 			pan();
 		}
-		if(key==GLFW_KEY_M && current_time-utime3>0.05){
+		if(key=='M' && current_time-utime3>0.05 && States.runs(SYSTEM_CONTROL)){
 			speed*=1.1;
 		}
-		if(key==GLFW_KEY_N && current_time-utime3>0.05){
+		if(key=='N' && current_time-utime3>0.05 && States.runs(SYSTEM_CONTROL)){
 			speed/=1.1;
 		}
-		if(key==GLFW_KEY_ENTER && ex==1){
+		if(key>='1' && key<='9' && key-'1'<(int)Levels.size())
+			Level=Levels[key-'1'];	// switching is just a pointer swap
+		if(key=='R')
+			rewindState();
+		if(key==KEY_ENTER && (States.state==STATE_MENU || States.state==STATE_GAMEOVER)){
 			initvar();
-			ex=0;
+			States.set(STATE_PLAYING);
 		}
 
 	}
@@ -478,94 +850,193 @@ void keyboard (GLFWwindow* window, int key, int scancode, int action, int mods)
 }
 
 /* Executed for character input (like in text boxes) */
-void keyboardChar (GLFWwindow* window, unsigned int key)
+void keyboardChar (unsigned int key)
 {
+	invalidate();
 	switch (key) {
 		case 'Q':
 		case 'q':
-			quit(window);
+			quit();
 			break;
 		default:
 			break;
 	}
 }
 
+/* Cursor position (screen coordinates, as Platform::cursorPos returns them) to
+   world coordinates, through the inverse of the current projection and view.
+   Window size rather than framebuffer size keeps this right on HiDPI screens. */
+glm::vec2 screenToWorld (double lx, double ly)
+{
+	int width, height;
+	Window->windowSize(width, height);
+	glm::vec4 ndc (2*lx/width - 1, 1 - 2*ly/height, 0, 1);
+	glm::vec4 world = glm::inverse(Matrices.projection * Matrices.view) * ndc;
+	return glm::vec2(world.x / world.w, world.y / world.w);
+}
+
+/* World point under the cursor when the right button went down; dragging
+   moves the camera so it stays there */
+glm::vec2 pan_grab;
+
+/* Things that can be clicked, with their world-space bounds */
+enum PickId { PICK_NONE, PICK_RED, PICK_GREEN, PICK_CANNON, PICK_PAUSE, PICK_RESTART, PICK_PLAY };
+
+struct Pickable {
+	float minx, miny, maxx, maxy;
+	PickId id;
+
+	bool operator< (const Pickable &other) const { return minx < other.minx; }
+};
+
+/* Bounds sorted by left edge: a query binary-searches the last box starting
+   left of the point and walks back only as far as the widest box reaches.
+   Boxes wider than WIDE (the cannon's whole track) would make that walk
+   the whole field, so they are kept apart and tested after the rest. */
+struct PickIndex {
+	static constexpr float WIDE = 2;
+
+	vector<Pickable> items, wide;
+	float widest;
+
+	void build (const vector<Pickable> &boxes) {
+		items.clear();
+		wide.clear();
+		widest = 0;
+		for (size_t i=0; i<boxes.size(); i++) {
+			float width = boxes[i].maxx - boxes[i].minx;
+			if (width > WIDE)
+				wide.push_back(boxes[i]);
+			else {
+				items.push_back(boxes[i]);
+				widest = max(widest, width);
+			}
+		}
+		sort(items.begin(), items.end());
+		sort(wide.begin(), wide.end());
+	}
+	static bool inside (const Pickable &box, glm::vec2 p) {
+		return p.x >= box.minx && p.x <= box.maxx && p.y >= box.miny && p.y <= box.maxy;
+	}
+	PickId query (glm::vec2 p) const {
+		Pickable probe = { p.x, 0, 0, 0, PICK_NONE };
+		vector<Pickable>::const_iterator it = upper_bound(items.begin(), items.end(), probe);
+		while (it != items.begin()) {
+			--it;
+			if (it->minx < p.x - widest)
+				break;
+			if (inside(*it, p))
+				return it->id;
+		}
+		// like the sorted walk, a box starting further right wins
+		for (size_t i=wide.size(); i>0; i--)
+			if (inside(wide[i-1], p))
+				return wide[i-1].id;
+		return PICK_NONE;
+	}
+} Picking;
+
+/* Rebuild the index from where things are right now */
+void updatePicking ()
+{
+	vector<Pickable> boxes;
+	if (States.state==STATE_GAMEOVER) {
+		Pickable restartbox = { -0.6, -0.7, 1.4, 0, PICK_RESTART };
+		boxes.push_back(restartbox);
+	}
+	else if (States.state==STATE_MENU) {
+		Pickable playbox = { -0.25, -0.6, 0.25, -0.1, PICK_PLAY };
+		boxes.push_back(playbox);
+	}
+	else {
+		float red = Level->red.x+position1, green = Level->green.x+position2;
+		const LevelCannon &cannon = Level->cannon;
+		Pickable pausebox = { 2.75, 3.45, 3.25, 3.95, PICK_PAUSE };
+		Pickable redbox = { red-0.3f, -4, red+0.6f, -2.6f, PICK_RED };
+		Pickable greenbox = { green-0.3f, -4, green+0.6f, -2.6f, PICK_GREEN };
+		// the whole track the cannon slides along, as before
+		Pickable cannonbox = { -8, cannon.y+cannon.min-0.8f, cannon.x+1.0f, cannon.y+cannon.max+0.8f, PICK_CANNON };
+		boxes.push_back(pausebox);
+		boxes.push_back(redbox);
+		boxes.push_back(greenbox);
+		boxes.push_back(cannonbox);
+	}
+	Picking.build(boxes);
+}
+
 /* Executed when a mouse button is pressed/released */
-void mouseButton (GLFWwindow* window, int button, int action, int mods)
+void mouseButton (int button, int action)
 {
+	invalidate();
 	switch (button) {
-		case GLFW_MOUSE_BUTTON_LEFT:
-			if (action == GLFW_RELEASE)
+		case BUTTON_LEFT:
+			if (action == ACTION_RELEASE)
 				triangle_rot_dir *= -1;
 			break;
-		case GLFW_MOUSE_BUTTON_RIGHT:
-			if (action == GLFW_RELEASE) {
+		case BUTTON_RIGHT:
+			if (action == ACTION_RELEASE) {
 				rectangle_rot_dir *= -1;
 			}
 			break;
 		default:
 			break;
 	}
-	if (button == GLFW_MOUSE_BUTTON_LEFT) {
-		if(GLFW_PRESS == action)
+	if (button == BUTTON_LEFT) {
+		if(ACTION_PRESS == action)
 			lmouse = 1;
-		else if(GLFW_RELEASE == action){
+		else if(ACTION_RELEASE == action){
 			lmouse = 0;
 			leftmove=0;
 			rightmove=0;
 			moverifle=0;
 		}
 	}
-	if (button == GLFW_MOUSE_BUTTON_RIGHT) {
-		if(GLFW_PRESS == action)
+	if (button == BUTTON_RIGHT) {
+		if(ACTION_PRESS == action){
 			rmouse = 1;
-		else if(GLFW_RELEASE == action)
+			double lx, ly;
+			Window->cursorPos(lx, ly);
+			pan_grab = screenToWorld(lx, ly);
+		}
+		else if(ACTION_RELEASE == action)
 			rmouse = 0;
 	}
 	if(lmouse==1){
 		double lx;
 		double ly;
-		glfwGetCursorPos(window, &lx, &ly);
-		if(ex==1 && lx>700 && lx<890 && ly>405 && ly<474){
-			//ex=0;
+		Window->cursorPos(lx, ly);
+		glm::vec2 world = screenToWorld(lx, ly);
+		updatePicking();
+		PickId picked = Picking.query(world);
+		if(picked==PICK_RESTART || picked==PICK_PLAY){
 			initvar();
-			ex=0;
-
+			States.set(STATE_PLAYING);
 		}
-		else if(ex==0){
-
-			if(lx<1050 && lx>1020 && ly>20 && ly<50){
-				if(flagp==0)
-				flagp=1;
-				else
-					flagp=0;
-			}
-			else if((lx < (-3.15+position1)*94+50+94*8) && ((-3.15+position1)*94-25+94*8) <lx && ly>600){
+		else if(picked==PICK_PAUSE)
+			States.set(States.state==STATE_PLAYING ? STATE_PAUSED : STATE_PLAYING);
+		else if(States.runs(SYSTEM_CONTROL)){
+			if(picked==PICK_RED){
 				leftmove=1;
 				rightmove=0;
 				moverifle=0;
 			}
-			else if(ly>600 && lx < (2.85+position2)*94+50+94*8 && lx>(2.85+position2)*94-25+94*8){
+			else if(picked==PICK_GREEN){
 				leftmove=0;
 				rightmove=1;
 				moverifle=0;
 			}
-			else if(lx>0 && lx<200 && ly<600){
+			else if(picked==PICK_CANNON){
 				moverifle=1;
 				leftmove=0;
 				rightmove=0;
 			}
-			else if(ly<600 && lx>200){
+			else if(world.y>-2){
 				leftmove=0;
 				rightmove=0;
 				moverifle=0;
-				press++;
-				flag3=1;
-				position4=-1*atan((ly-330+position3*110)/(lx-30))*(180/M_PI);
-				position6[press]=position4;
-				position7[press]=position3;
-				xcollide[press]=-7.6;
-				ycollide[press]=0.55;
+				// aim from the barrel pivot at the clicked point
+				position4=atan2(world.y-(Level->cannon.y+position3), world.x-Level->cannon.x)*(180/M_PI);
+				fireLaser();
 			}
 		}
 
@@ -573,42 +1044,55 @@ void mouseButton (GLFWwindow* window, int button, int action, int mods)
 
 
 }
-void drag (GLFWwindow* window){
+void drag (){
 	double lx;
 	double ly;
-	glfwGetCursorPos(window, &lx, &ly);
-	if(leftmove==1){
-		position1=((lx-94*8)/94)+3.15;
+	Window->cursorPos(lx, ly);
+	glm::vec2 world = screenToWorld(lx, ly);
+	bool control=States.runs(SYSTEM_CONTROL);
+	if(leftmove==1 && control){
+		position1=world.x-Level->red.x;
 	}
-	if(rightmove==1){
-		position2=((lx-94*8)/94)-2.85;
+	if(rightmove==1 && control){
+		position2=world.x-Level->green.x;
 	}
 	if(rmouse==1){
-		xpos=((lx-94*8)/394);
-		ypos=-1*((ly-100*4)/400);
+		// keep the grabbed world point under the cursor
+		xpos+=pan_grab.x-world.x;
+		ypos+=pan_grab.y-world.y;
 		pan();
 	}
-	if(moverifle==1){
-		position3=-1*((ly-100*6)/100)-2.65;
+	if(moverifle==1 && control){
+		position3=world.y-Level->cannon.y;
 	}
 	// printf("%lf %lf %f\n",lx,ly,position1);
 
 }
 
 
+/* Executed when the window contents were damaged (uncovered, restored, ...) */
+void refreshWindow ()
+{
+	invalidate();
+}
+
 /* Executed when window is resized to 'width' and 'height' */
 /* Modify the bounds of the screen here in glm::ortho or Field of View in glm::Perspective */
-void reshapeWindow (GLFWwindow* window, int width, int height)
+void resizeStaticLayer (int width, int height);
+
+void reshapeWindow (int width, int height)
 {
+	invalidate();
 	int fbwidth=width, fbheight=height;
-	/* With Retina display on Mac OS X, GLFW's FramebufferSize
-	   is different from WindowSize */
-	glfwGetFramebufferSize(window, &fbwidth, &fbheight);
+	/* With Retina display on Mac OS X, the framebuffer size
+	   is different from the window size */
+	Window->framebufferSize(fbwidth, fbheight);
 
 	GLfloat fov = 90.0f;
 
 	// sets the viewport of openGL renderer
-	glViewport (0, 0, (GLsizei) fbwidth, (GLsizei) fbheight);
+	commands().viewport (0, 0, (GLsizei) fbwidth, (GLsizei) fbheight);
+	resizeStaticLayer(fbwidth, fbheight);
 
 	// set the projection matrix as perspective
 	/* glMatrixMode (GL_PROJECTION);
@@ -622,7 +1106,121 @@ void reshapeWindow (GLFWwindow* window, int width, int height)
 	Matrices.projection = glm::ortho(-8.0f, 8.0f, -4.0f, 4.0f, 0.1f, 500.0f);
 }
 
-VAO *triangle, *rectangle,*tri,*play, *circle,*pause1,*pause2, *circle1,*circle41,*restart,*pause, *rectangle1,*rectang,*laser[10000],*level[7],*segment[7],*scoredis[7], *circle2, *circle3, *rectangle2, *rectangle3, *rectangle4, *rectangle5, *rectangle6, *rectangle7, *circle4, *circle5, *line, *line1, *rect[10000],*rectan;
+VAO *triangle, *rectangle, *rectangle1,*rectang,*laser, *rectangle2, *rectangle3, *rectangle4, *line, *line1, *rectan;
+
+/* Round shapes are drawn from one 4-vertex quad by the Sdf shader, which
+   evaluates their signed distance per fragment */
+struct SdfShape {
+	float halfw, halfh;	// half extent
+	float corner;		// corner radius
+	float ring;			// band width, 0 for filled
+	float r, g, b;
+};
+
+constexpr SdfShape sdfCircle (float radius, float r, float g, float b)
+{
+	return SdfShape{ radius, radius, radius, 0, r, g, b };
+}
+
+constexpr SdfShape sdfRing (float radius, float width, float r, float g, float b)
+{
+	return SdfShape{ radius, radius, radius, width, r, g, b };
+}
+
+constexpr SdfShape sdfRoundRect (float halfw, float halfh, float corner, float r, float g, float b)
+{
+	return SdfShape{ halfw, halfh, corner, 0, r, g, b };
+}
+
+const SdfShape redWheel = sdfCircle(0.35, 1,0.3,0.3);
+const SdfShape greenWheel = sdfCircle(0.35, 0.4,1,0.4);
+// The cannon's base used to be 360 wireframe slices, which fill in to a disc
+const SdfShape cannonBase = sdfCircle(0.6, 0.645098,0.270588,0.145098);
+const SdfShape cannonBaseMoving = sdfCircle(0.6, 0.645098,0.470588,0.345098);
+
+VAO *sdfQuad;
+GLuint sdfProgram;
+struct {
+	GLint MVP, halfSize, corner, ring, color;
+} SdfUniforms;
+
+void drawSdf (const SdfShape &shape, const glm::mat4 &MVP)
+{
+	commands().useProgram(sdfProgram);
+	commands().uniformMatrix4(SdfUniforms.MVP, &MVP[0][0]);
+	commands().uniform2f(SdfUniforms.halfSize, shape.halfw, shape.halfh);
+	commands().uniform1f(SdfUniforms.corner, shape.corner);
+	commands().uniform1f(SdfUniforms.ring, shape.ring);
+	commands().uniform3f(SdfUniforms.color, shape.r, shape.g, shape.b);
+	// the anti-aliased rim blends with what is already there
+	commands().enable(GL_BLEND);
+	commands().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	draw3DObject(sdfQuad);
+	commands().disable(GL_BLEND);
+	commands().useProgram(programID);
+}
+
+/* Sprite renderer: HUD, buttons and bricks are quads from one atlas texture,
+   queued while drawing and submitted with a single draw at the end of the frame */
+SpriteAtlas Atlas;
+SpriteBatch Sprites;
+GLuint spriteProgram, spriteTexture, spriteArray, spriteBuffer;
+GLint spriteMVP;
+long sprite_capacity=0;
+
+// Buttons sit in front of the scene, bricks and HUD behind it
+const float SPRITE_FRONT=0.01f, SPRITE_BACK=-0.01f;
+
+void createSprites ()
+{
+	buildAtlas(Atlas);
+	glGenTextures(1, &spriteTexture);
+	glBindTexture(GL_TEXTURE_2D, spriteTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Atlas.width, Atlas.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, &Atlas.pixels[0]);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	Resources.adoptTexture(spriteTexture, Atlas.pixels.size());
+
+	glGenVertexArrays(1, &spriteArray);
+	glBindVertexArray(spriteArray);
+	glGenBuffers(1, &spriteBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, spriteBuffer);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, r));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, u));
+	Resources.adoptVertexArray(spriteArray);
+	Resources.adoptBuffer(spriteBuffer, 0);
+}
+
+/* Submit everything queued this frame */
+void drawSprites (const glm::mat4 &VP)
+{
+	if(Sprites.vertices.empty())
+		return;
+	long size=Sprites.vertices.size()*sizeof(SpriteVertex);
+	commands().useProgram(spriteProgram);
+	commands().uniformMatrix4(spriteMVP, &VP[0][0]);
+	commands().bindTexture(spriteTexture);
+	commands().bindVertexArray(spriteArray);
+	if(size>sprite_capacity){
+		sprite_capacity=size*2;
+		Resources.resizeBuffer(spriteBuffer, sprite_capacity);
+	}
+	// orphan last frame's storage instead of waiting for the GPU to finish with it
+	commands().streamVertices(spriteBuffer, sprite_capacity, &Sprites.vertices[0], size);
+	commands().polygonMode(GL_FILL);
+	commands().enable(GL_BLEND);
+	commands().blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	commands().drawArrays(GL_TRIANGLES, 0, Sprites.vertices.size());
+	commands().disable(GL_BLEND);
+	draw_calls++;
+	Sprites.clear();
+}
 
 // Creates the triangle object used in this sample code
 void createTriangle ()
@@ -646,33 +1244,9 @@ void createTriangle ()
 		0,0,1, // color 1
 		0,0,1, // color 2
 	};
-	static const GLfloat vertex_buffer [] = {
-		0, 0,0, // vertex 0
-		-0.3,0.2,0, // vertex 1
-		-0.3,-0.2,0, // vertex 2
-	};
-	static const GLfloat playvertex [] = {
-		0, 0,0, // vertex 0
-		-0.2,0.1,0, // vertex 1
-		-0.2,-0.1,0, // vertex 2
-	};
-
-	static const GLfloat color_buffer [] = {
-		1,1,1, // color 0
-		1,1,1, // color 1
-		1,1,1, // color 2
-	};
-	static const GLfloat playcolor [] = {
-		1,1,1, // color 0
-		1,1,1, // color 1
-		1,1,1, // color 2
-	};
-
 	// create3DObject creates and returns a handle to a VAO that can be used later
 	line = create3DObject(GL_TRIANGLES, 3, vertex_buffer_data, color_buffer_data, GL_LINE);
 	line1 = create3DObject(GL_TRIANGLES, 3, vertex_buffer_data1, color_buffer_data, GL_LINE);
-	tri = create3DObject(GL_TRIANGLES, 3, vertex_buffer, color_buffer, GL_FILL);
-	play = create3DObject(GL_TRIANGLES, 3, playvertex, playcolor, GL_FILL);
 
 
 
@@ -682,78 +1256,12 @@ void createTriangle ()
 void createRectangle ()
 {
 	// GL3 accepts only Triangles. Quads are not supported
-	static const GLfloat gundata [] = {
-		-0.2,-0.2,0, // vertex 1
-		0.3,-0.2,0, // vertex 2
-		0.3, 0.3,0, // vertex 3
-
-		0.3, 0.3,0, // vertex 3
-		-0.2, 0.3,0, // vertex 4
-		-0.2,-0.2,0  // vertex 1
-	};
-	static const GLfloat rectanglegundata [] = {
-		-0.2,-0.1,0, // vertex 1
-		0.8,-0.1,0, // vertex 2
-		0.8, 0.1,0, // vertex 3
-
-		0.8, 0.1,0, // vertex 3
-		-0.2, 0.1,0, // vertex 4
-		-0.2,-0.1,0  // vertex 1
-	};
-	static const GLfloat mirror [] = {
-		-0.2,-0.1,0, // vertex 1
-		0.9,-0.1,0, // vertex 2
-		0.9, 0.0,0, // vertex 3
-
-		0.9, 0.0,0, // vertex 3
-		-0.2, 0.0,0, // vertex 4
-		-0.2,-0.1,0  // vertex 1
-	};
-	static const GLfloat vertex_buffer_data [] = {
-		-0.2,-0.2,0, // vertex 1
-		0.5,-0.2,0, // vertex 2
-		0.5, 0.5,0, // vertex 3
-
-		0.5, 0.5,0, // vertex 3
-		-0.2, 0.5,0, // vertex 4
-		-0.2,-0.2,0  // vertex 1
-	};
-	GLfloat vertexlaser [] = {
-		0,0,0, // vertex 1
-		0.5,0,0, // vertex 2
-		0.5, 0.1,0, // vertex 3
-
-		0.5, 0.1,0, // vertex 3
-		0, 0.1,0, // vertex 4
-		0,0,0  // vertex 1
-	};
-	GLfloat vertexrestart [] = {
-		0,0,0, // vertex 1
-		2,0,0, // vertex 2
-		2, 0.7,0, // vertex 3
-
-		2, 0.7,0, // vertex 3
-		0, 0.7,0, // vertex 4
-		0,0,0  // vertex 1
-	};
-	GLfloat display [] = {
-		0,0,0, // vertex 1
-		0.2,0,0, // vertex 2
-		0.2, 0.05,0, // vertex 3
-
-		0.2, 0.05,0, // vertex 3
-		0, 0.05,0, // vertex 4
-		0,0,0 
-	};
-	GLfloat pausesymbol [] = {
-		0,0,0, // vertex 1
-		0.2,0,0, // vertex 2
-		0.2, 0.05,0, // vertex 3
-
-		0.2, 0.05,0, // vertex 3
-		0, 0.05,0, // vertex 4
-		0,0,0 
-	};
+	static constexpr GeometryTable<18> gundata = rectTable(-0.2,-0.2, 0.3,0.3);
+	static constexpr GeometryTable<18> rectanglegundata = rectTable(-0.2,-0.1, 0.8,0.1);
+	// Unit length, stretched to each level mirror's extent when drawn
+	static constexpr GeometryTable<18> mirror = rectTable(0,-0.1, 1,0.0);
+	static constexpr GeometryTable<18> vertex_buffer_data = rectTable(-0.2,-0.2, 0.5,0.5);
+	static constexpr GeometryTable<18> vertexlaser = rectTable(0,0, 0.5,0.1);
 
 	static const GLfloat color_buffer_data [] = {
 		1,0.2,0.2, // color 1
@@ -773,42 +1281,11 @@ void createRectangle ()
 		0.8,1,0.8, // color 4
 		0.2,1,0.2  // color 1
 	};
-	static const GLfloat color_buffer [] = {
-		1,0.7,0.7, // color 1
-		1,0.7,0.7, // color 2
-		1,0.7,0.7, // color 3
-
-		1,0.7,0.7, // color 3
-		1,0.7,0.7, // color 4
-		1,0.7,0.7  // color 1
-	};
-	static const GLfloat color_buffer1 [] = {
-		0.7,1,0.7, // color 1
-		0.7,1,0.7, // color 2
-		0.7,1,0.7, // color 3
-
-		0.7,1,0.7, // color 3
-		0.7,1,0.7, // color 4
-		0.7,1,0.7  // color 1
-	};
-	static const GLfloat colorgundata [] = {
-		0.645098,0.270588,0.145098,
-		0.645098,0.270588,0.145098,// color 1
-		0.645098,0.270588,0.145098,// color 1
-		0.645098,0.270588,0.145098,// color 1
-		0.645098,0.270588,0.145098,// color 1
-		0.645098,0.270588,0.145098// color 1
-	};
-	static const GLfloat colormirror [] = {
-		0.5,0.5,0.5, // color 1
-		0.5,0.5,0.5, // color 2
-		0.5,0.5,0.5, // color 3
-		0.5,0.5,0.5, // color 1
-		0.5,0.5,0.5, // color 2
-		0.5,0.5,0.5
-			// color 1
-	};
-	GLfloat colorlaser [] = {
+	static constexpr GeometryTable<18> color_buffer = colorTable<6>(1,0.7,0.7);
+	static constexpr GeometryTable<18> color_buffer1 = colorTable<6>(0.7,1,0.7);
+	static constexpr GeometryTable<18> colorgundata = colorTable<6>(0.645098,0.270588,0.145098);
+	static constexpr GeometryTable<18> colormirror = colorTable<6>(0.5,0.5,0.5);
+	static const GLfloat colorlaser [] = {
 		0.5,0.5,0.5, // color 1
 		0.5,0.5,0.5, // color 2
 		0.5,0.5,0.5, // color 3
@@ -817,239 +1294,202 @@ void createRectangle ()
 		0.5,0.5,0.5
 			// color 1
 	};
-	GLfloat colordisplay [] = {
-		0,0,1,
-		0,0,1,
-		0,0,1,
-		0,0,1,
-		0,0,1,
-		0,0,1
-			// color 1
-	};
-	GLfloat colorpause [] = {
-		1,1,1,
-		1,1,1,
-		1,1,1,
-		1,1,1,
-		1,1,1,
-		1,1,1
-			// color 1
-	};
-	
 
 	// create3DObject creates and returns a handle to a VAO that can be used later
-	rectangle = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data, GL_FILL);
-	rectan = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer, GL_FILL);
+	rectangle = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data.values(), color_buffer_data, GL_FILL);
+	rectan = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data.values(), color_buffer.values(), GL_FILL);
 
-	rectangle1 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data1, GL_FILL);
-	rectang = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer1, GL_FILL);
-	restart = create3DObject(GL_TRIANGLES, 6, vertexrestart, color_buffer_data1, GL_FILL);
-	pause1 =  create3DObject(GL_TRIANGLES, 6,pausesymbol, colorpause, GL_FILL);
-	pause2 =  create3DObject(GL_TRIANGLES, 6, pausesymbol, colorpause, GL_FILL);
+	rectangle1 = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data.values(), color_buffer_data1, GL_FILL);
+	rectang = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data.values(), color_buffer1.values(), GL_FILL);
 
-	rectangle2 = create3DObject(GL_TRIANGLES, 6, gundata, colorgundata, GL_FILL);
-	rectangle3 = create3DObject(GL_TRIANGLES, 6, rectanglegundata, colorgundata, GL_FILL);
-	rectangle4 = create3DObject(GL_TRIANGLES, 6, mirror, colormirror, GL_FILL);
-	rectangle5 = create3DObject(GL_TRIANGLES, 6, mirror, colormirror, GL_FILL);
-	rectangle6 = create3DObject(GL_TRIANGLES, 6, mirror, colormirror, GL_FILL);
-	rectangle7 = create3DObject(GL_TRIANGLES, 6, mirror, colormirror, GL_FILL);
-	for(int i=0;i<10000;i++)
-		laser[i] = create3DObject(GL_TRIANGLES, 6, vertexlaser, colorlaser, GL_FILL);
-	for(int i=0;i<7;i++)
-		segment[i]=create3DObject(GL_TRIANGLES, 6, display, colordisplay, GL_FILL);
-	for(int i=0;i<7;i++)
-		scoredis[i]=create3DObject(GL_TRIANGLES, 6, display, colordisplay, GL_FILL);
-	for(int i=0;i<7;i++)
-		level[i]=create3DObject(GL_TRIANGLES, 6, display, colordisplay, GL_FILL);
+	rectangle2 = create3DObject(GL_TRIANGLES, 6, gundata.values(), colorgundata.values(), GL_FILL);
+	rectangle3 = create3DObject(GL_TRIANGLES, 6, rectanglegundata.values(), colorgundata.values(), GL_FILL);
+	rectangle4 = create3DObject(GL_TRIANGLES, 6, mirror.values(), colormirror.values(), GL_FILL);
+	// Every laser shot shares this one VAO
+	laser = create3DObject(GL_TRIANGLES, 6, vertexlaser.values(), colorlaser, GL_FILL);
 
 
 
 
 
 }
+/* Wheels and the cannon base: one quad for all of them, see drawSdf() */
 void createCircle()
 {
-	GLfloat vertex_buffer_data [360*9]={0};
-	GLfloat vertex_buffer_data1 [360*9]={0};
-	GLfloat vertex_buffer_data2 [360*9]={0};
-	GLfloat vertex_buffer_data3 [360*9]={0};
-
+	static const GLfloat quad [] = {
+		-1,-1,0,
+		1,-1,0,
+		-1,1,0,
+		1,1,0,
+	};
+	sdfQuad = create3DObject(GL_TRIANGLE_STRIP, 4, quad, 0, 0, 0, GL_FILL);
+}
 
-	for(int i=0;i<360;i++)
-	{
-		vertex_buffer_data[9*i]=0;
-		vertex_buffer_data[9*i+1]=0;
-		vertex_buffer_data[9*i+2]=0;
-		vertex_buffer_data[9*i+3]=0.35*cos(i*M_PI/180);
-		vertex_buffer_data[9*i+4]=0.35*sin(i*M_PI/180);
-		vertex_buffer_data[9*i+5]=0;
-		vertex_buffer_data[9*i+6]=0.35*cos((i+1)*M_PI/180);
-		vertex_buffer_data[9*i+7]=0.35*sin((i+1)*M_PI/180);
-		vertex_buffer_data[9*i+8]=0;
-	}
-	for(int i=0;i<360;i++)
-	{
-		vertex_buffer_data1[9*i]=0;
-		vertex_buffer_data1[9*i+1]=0;
-		vertex_buffer_data1[9*i+2]=0;
-		vertex_buffer_data1[9*i+3]=0.6*cos(i*M_PI/180);
-		vertex_buffer_data1[9*i+4]=0.6*sin(i*M_PI/180);
-		vertex_buffer_data1[9*i+5]=0;
-		vertex_buffer_data1[9*i+6]=0.6*cos((i+1)*M_PI/180);
-		vertex_buffer_data1[9*i+7]=0.6*sin((i+1)*M_PI/180);
-		vertex_buffer_data1[9*i+8]=0;
-	}
-	for(int i=0;i<360;i++)
-	{
-		vertex_buffer_data2[9*i]=0;
-		vertex_buffer_data2[9*i+1]=0;
-		vertex_buffer_data2[9*i+2]=0;
-		vertex_buffer_data2[9*i+3]=0.35*cos(i*M_PI/180);
-		vertex_buffer_data2[9*i+4]=0.35*sin(i*M_PI/180);
-		vertex_buffer_data2[9*i+5]=0;
-		vertex_buffer_data2[9*i+6]=0.35*cos((i+1)*M_PI/180);
-		vertex_buffer_data2[9*i+7]=0.35*sin((i+1)*M_PI/180);
-		vertex_buffer_data2[9*i+8]=0;
-	}
-	for(int i=0;i<360;i++)
-	{
-		vertex_buffer_data3[9*i]=0;
-		vertex_buffer_data3[9*i+1]=0;
-		vertex_buffer_data3[9*i+2]=0;
-		vertex_buffer_data3[9*i+3]=0.25*cos(i*M_PI/180);
-		vertex_buffer_data3[9*i+4]=0.25*sin(i*M_PI/180);
-		vertex_buffer_data3[9*i+5]=0;
-		vertex_buffer_data3[9*i+6]=0.25*cos((i+1)*M_PI/180);
-		vertex_buffer_data3[9*i+7]=0.25*sin((i+1)*M_PI/180);
-		vertex_buffer_data3[9*i+8]=0;
-	}
-	GLfloat color_buffer_data [360*9];
-	GLfloat color_buffer_data1 [360*9];
-	GLfloat color_buffer_data2 [360*9];
-	GLfloat color_buffer2 [360*9];
 
-	GLfloat color_buffer_data3 [360*9];
-
-	static GLfloat color_buffer_data4 [360*9];
+/* Pick x and color of brick i from the active level's spawn distribution.
+   Done when the brick is revealed, so a level switch applies from the next brick on */
+void rollBrick (int i)
+{
+	BrickSpawn spawn=Spawner.next(Level->spawn);
+	Bricks.f(FIELD_X,i)=spawn.x;
+	Bricks.i(FIELD_COLOR,i)=spawn.color;
+}
 
+/* World rectangle on screen this frame. Bricks, lasers and HUD sprites are
+   tested against it before submission, which matters once zoomed in */
+struct ViewBounds {
+	float x0, y0, x1, y1;
+};
+ViewBounds View;
+long cull_drawn=0, cull_culled=0;
 
+/* The projection is a plain ortho box (see pan()), so the world extent
+   follows from the scale and offset on the diagonal of VP */
+void updateView (const glm::mat4 &VP)
+{
+	View.x0 = (-1-VP[3][0])/VP[0][0];
+	View.x1 = (1-VP[3][0])/VP[0][0];
+	View.y0 = (-1-VP[3][1])/VP[1][1];
+	View.y1 = (1-VP[3][1])/VP[1][1];
+}
 
-	for (int i = 0; i<360*9 ; i+=3)
-	{
-		color_buffer_data[i]=1;
-		color_buffer_data[i+1]=0.3;
-		color_buffer_data[i+2]=0.3;
-	}
-	for (int i = 0; i<360*9 ; i+=3)
-	{
-		color_buffer_data1[i]=0.4;
-		color_buffer_data1[i+1]=1;
-		color_buffer_data1[i+2]=0.4;
-	}
-	for (int i = 0; i<360*9 ; i+=3)
-	{
-		color_buffer_data2[i]=0.645098;
-		color_buffer_data2[i+1]=0.270588;
-		color_buffer_data2[i+2]= 0.145098;
-	}
-	for (int i = 0; i<360*9 ; i+=3)
-	{
-		color_buffer2[i]=0.645098;
-		color_buffer2[i+1]=0.470588;
-		color_buffer2[i+2]= 0.345098;
-	}
-	for (int i = 0; i<360*9 ; i+=3)
-	{
-		color_buffer_data3[i]=0;
-		color_buffer_data3[i+1]=0;
-		color_buffer_data3[i+2]=1;
+bool onScreen (float x0, float y0, float x1, float y1)
+{
+	if(x1<View.x0 || x0>View.x1 || y1<View.y0 || y0>View.y1){
+		cull_culled++;
+		return false;
 	}
-	circle = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data,color_buffer_data,GL_FILL);
-	circle1 = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data,color_buffer_data,GL_FILL);
-	circle2 = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data,color_buffer_data1,GL_FILL);
-	circle3 = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data,color_buffer_data1,GL_FILL);
-	circle4 = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data1,color_buffer_data2,GL_LINE);
-	circle41 = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data1,color_buffer2,GL_LINE);
-
-	circle5 = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data2,color_buffer_data3,GL_LINE);
-	pause = create3DObject(GL_TRIANGLES,360*3,vertex_buffer_data3,color_buffer_data4,GL_FILL);
-
+	cull_drawn++;
+	return true;
+}
 
+void addSprite (SpriteId id, float x, float y, float z, float r=1, float g=1, float b=1)
+{
+	const Sprite &sprite = Atlas.sprites[id];
+	if(onScreen(x+sprite.x0, y+sprite.y0, x+sprite.x1, y+sprite.y1))
+		Sprites.add(Atlas, id, x, y, z, r, g, b);
+}
 
+/* Mirrors, the ground line and the SCORE/LEVEL labels only change with the
+   view, the level or game over. They are rendered into a texture when one of
+   those changes, and every frame starts by laying it down as one quad */
+struct {
+	GLuint framebuffer, texture, array, buffer;
+	bool dirty;
+	// what the texture was rendered for
+	glm::mat4 VP;
+	const LevelData *level;
+	bool over;
+} Layer;
+
+void createStaticLayer ()
+{
+	glGenTextures(1, &Layer.texture);
+	glBindTexture(GL_TEXTURE_2D, Layer.texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	Resources.adoptTexture(Layer.texture, 0);
+	glGenFramebuffers(1, &Layer.framebuffer);
+	Resources.adoptFramebuffer(Layer.framebuffer);
+
+	// Covers clip space, so it is drawn with an identity MVP by the sprite shader
+	static const SpriteVertex quad[6] = {
+		{ -1,-1,0, 0,0, 1,1,1,1 }, { 1,-1,0, 1,0, 1,1,1,1 }, { 1,1,0, 1,1, 1,1,1,1 },
+		{ 1,1,0, 1,1, 1,1,1,1 }, { -1,1,0, 0,1, 1,1,1,1 }, { -1,-1,0, 0,0, 1,1,1,1 },
+	};
+	glGenVertexArrays(1, &Layer.array);
+	glBindVertexArray(Layer.array);
+	glGenBuffers(1, &Layer.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, Layer.buffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, x));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, r));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), (void*)offsetof(SpriteVertex, u));
+	Resources.adoptVertexArray(Layer.array);
+	Resources.adoptBuffer(Layer.buffer, sizeof(quad));
 }
 
+/* The texture matches the framebuffer pixel for pixel */
+void resizeStaticLayer (int width, int height)
+{
+	commands().textureStorage(Layer.texture, width, height);
+	Resources.resizeTexture(Layer.texture, 4L*width*height);
+	commands().attachTexture(Layer.framebuffer, Layer.texture);
+	Layer.dirty=true;
+}
 
-void createobjects()
+void renderStaticLayer (const glm::mat4 &VP, int sx, int sy)
 {
-	int i;
-	for(i=0;i<10000;i++){
-		GLfloat vertex_buffer_data [18]={0};
-
-		int random_integer = -4 + rand() % 12;
-		posx[i]=random_integer;
-		if(random_integer>=-4 && random_integer<=0)
-			random2[i] = rand()%2;
-		else{
-			random2[i] = rand()%3;
-			if(random2[i]==1)
-				random2[i]+=1;
+	glm::mat4 MVP;
+	commands().bindFramebuffer(Layer.framebuffer);
+	// opaque white, so the composited quad hides the frame's own clear
+	commands().clearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	commands().clear(GL_COLOR_BUFFER_BIT);
+	commands().clearColor(1.0f, 1.0f, 1.0f, 0.0f);
+	commands().useProgram(programID);
+	if(States.state!=STATE_GAMEOVER){
+		for(unsigned int m=0;m<Level->mirror_count;m++){
+			const LevelMirror &mirror=Level->mirrors[m];
+			Matrices.model = glm::mat4(1.0f);
+
+			glm::mat4 translateMirror = glm::translate (glm::vec3(mirror.x, mirror.y, 0));        // glTranslatef
+			glm::mat4 rotateMirror = glm::rotate((float)(mirror.angle*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
+			glm::mat4 extentMirror = glm::translate (glm::vec3(-mirror.back, 0, 0)) * glm::scale (glm::vec3(mirror.back+mirror.front, 1, 1));
+			Matrices.model *= (translateMirror * rotateMirror * extentMirror);
+			MVP = VP * Matrices.model;
+			commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
+			draw3DObject(rectangle4);
 		}
-		vertex_buffer_data [0] = random_integer;
-		vertex_buffer_data [1] = 3.4;
-		vertex_buffer_data [2] = 0;
-		vertex_buffer_data [3] = random_integer+0.2;
-		vertex_buffer_data [4] = 3.4;
-		vertex_buffer_data [5] = 0;
-		vertex_buffer_data [6] = random_integer+0.2;
-		vertex_buffer_data [7] = 3.7;
-		vertex_buffer_data [8] = 0;
-		vertex_buffer_data [9] = random_integer+0.2;
-		vertex_buffer_data [10] = 3.7;
-		vertex_buffer_data [11] = 0;
-		vertex_buffer_data [12] = random_integer;
-		vertex_buffer_data [13] = 3.7;
-		vertex_buffer_data [14] = 0;
-		vertex_buffer_data [15] = random_integer;
-		vertex_buffer_data [16] = 3.4;
-		vertex_buffer_data [17] = 0;
-
-		//R
-		GLfloat color_buffer_data1 [] = {
-			1,0,0, // color 1
-			1,0,0, // color 2
-			1,0,0, // color 3
-
-			1,0,0, // color 3
-			1,0,0, // color 4
-			1,0,0  // color 1
-		};
-		//G
-		GLfloat color_buffer_data2 [] = {
-			0,1,0, // color 1
-			0,1,0, // color 2
-			0,1,0, // color 3
-
-			0,1,0, // color 3
-			0,1,0, // color 4
-			0,1,0  // color 1
-		};
-		//B
-		GLfloat color_buffer_data3 [] = {
-			0,0,0, // color 1
-			0,0,0, // color 2
-			0,0,0, // color 3
-
-			0,0,0, // color 3
-			0,0,0, // color 4
-			0,0,0  // color 1
-		};
-		if(random2[i]==0)
-			rect[i] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data3, GL_FILL);
-		if(random2[i]==1)
-			rect[i] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data1, GL_FILL);
-		if(random2[i]==2)
-			rect[i] = create3DObject(GL_TRIANGLES, 6, vertex_buffer_data, color_buffer_data2, GL_FILL);
+
+		Matrices.model = glm::mat4(1.0f);
+
+		glm::mat4 translateRectangle5 = glm::translate (glm::vec3(0, 0.6, 0));        // glTranslatef
+		glm::mat4 rotateRectangle5 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
+		Matrices.model *= (translateRectangle5 * rotateRectangle5);
+		MVP = VP * Matrices.model;
+		commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
+		draw3DObject(line);
+		addSprite(SPRITE_LEVEL, -7.5, 3.5, SPRITE_BACK);
 	}
+	addSprite(SPRITE_SCORE, 4.2-sx, 3.5-sy, SPRITE_BACK);
+	drawSprites(VP);
+	commands().bindFramebuffer(0);
+	commands().useProgram(programID);
+}
+
+void drawStaticLayer (const glm::mat4 &VP, int sx, int sy)
+{
+	bool over=States.state==STATE_GAMEOVER;
+	if(Layer.dirty || VP!=Layer.VP || Level!=Layer.level || over!=Layer.over){
+		renderStaticLayer(VP, sx, sy);
+		Layer.VP=VP;
+		Layer.level=Level;
+		Layer.over=over;
+		Layer.dirty=false;
+	}
+	static const glm::mat4 identity(1.0f);
+	commands().useProgram(spriteProgram);
+	commands().uniformMatrix4(spriteMVP, &identity[0][0]);
+	commands().bindTexture(Layer.texture);
+	commands().bindVertexArray(Layer.array);
+	commands().polygonMode(GL_FILL);
+	// underneath everything else, so it must not claim any depth
+	commands().disable(GL_DEPTH_TEST);
+	commands().drawArrays(GL_TRIANGLES, 0, 6);
+	commands().enable(GL_DEPTH_TEST);
+	draw_calls++;
+	commands().useProgram(programID);
+}
+
+/* Queue brick i; bricks only differ by x offset and tint */
+void addBrick (float x, float y, int color)
+{
+	static const float tint[3][3] = { {0,0,0}, {1,0,0}, {0,1,0} };
+	const float *c = tint[color];
+	addSprite(SPRITE_BRICK, x, y, SPRITE_BACK, c[0], c[1], c[2]);
 }
 /* Render the scene with openGL */
 /* Edit this function according to your assignment */
@@ -1058,11 +1498,11 @@ void draw ()
 	int sx,sy,mul;
 	float vl;
 	// clear the color and depth in the frame buffer
-	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	commands().clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 	// use the loaded shader program
 	// Don't change unless you know what you are doing
-	glUseProgram (programID);
+	commands().useProgram(programID);
 
 	// Eye - Location of camera. Don't change unless you are sure!!
 	glm::vec3 eye ( 5*cos(camera_rotation_angle*M_PI/180.0f), 0, 5*sin(camera_rotation_angle*M_PI/180.0f) );
@@ -1079,6 +1519,7 @@ void draw ()
 	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
 	//  Don't change unless you are sure!!
 	glm::mat4 VP = Matrices.projection * Matrices.view;
+	updateView(VP);
 
 	// Send our transformation to the currently bound shader, in the "MVP" uniform
 	// For each model you render, since the MVP will be different (at least the M part)
@@ -1087,10 +1528,10 @@ void draw ()
 
 			// MVP = Projection * View * Model
 	dig=-1;
-	mul=score/100;
+	mul=score/Level->speed.step;
 	vl=1;
 	for(int i=0;i<mul;i++){
-		vl*=1.2;
+		vl*=Level->speed.growth;
 		speed=vl;
 
 	}
@@ -1105,171 +1546,115 @@ void draw ()
 	}
 
 
-	if(position1<-3)
-		position1=-3;
-	if(position1>2.9)
-		position1=2.9;
-	if(position2>4.2)
-		position2=4.2;
-	if(position2<-2)
-		position2=-2;
-	if(position3>2.9)
-		position3=2.9;
-	if(position3<-2.5)
-		position3=-2.5;
-	if(position4>70)
-		position4=70;
-	if(position4<-70)
-		position4=-70;
-	if(!ex)
+	if(position1<Level->red.min)
+		position1=Level->red.min;
+	if(position1>Level->red.max)
+		position1=Level->red.max;
+	if(position2>Level->green.max)
+		position2=Level->green.max;
+	if(position2<Level->green.min)
+		position2=Level->green.min;
+	if(position3>Level->cannon.max)
+		position3=Level->cannon.max;
+	if(position3<Level->cannon.min)
+		position3=Level->cannon.min;
+	if(position4>Level->cannon.tilt)
+		position4=Level->cannon.tilt;
+	if(position4<-Level->cannon.tilt)
+		position4=-Level->cannon.tilt;
+	if(States.state!=STATE_GAMEOVER)
 	{
 		sx=0;
 		sy=0;
 	}
-	if(ex==1)
+	else
 	{
 		sx=5.5;
 		sy=3.5;
-
-		Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateRectangle111 = glm::translate (glm::vec3(0.6, -0.35, 0));        // glTranslatef
-		glm::mat4 rotateRectangle111 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateRectangle111 * rotateRectangle111);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(tri);
-
-
-		Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateRectangle112 = glm::translate (glm::vec3(-0.6, -0.7, 0));        // glTranslatef
-		glm::mat4 rotateRectangle112 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateRectangle112 * rotateRectangle112);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(restart);
-
-
 	}
-	if(ex==0){
-if(flagp==1){
-		Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateRectangle114 = glm::translate (glm::vec3(3.12, 3.7, 0));        // glTranslatef
-		glm::mat4 rotateRectangle114 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateRectangle114 * rotateRectangle114);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(play);
-}
-if(flagp==0){
-Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateRectangle113 = glm::translate (glm::vec3(2.95, 3.6, 0));        // glTranslatef
-		glm::mat4 rotateRectangle113 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateRectangle113 * rotateRectangle113);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(pause1);
-
-		Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateRectangle114 = glm::translate (glm::vec3(3.1, 3.6, 0));        // glTranslatef
-		glm::mat4 rotateRectangle114 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateRectangle114 * rotateRectangle114);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(pause2);
-}
-		Matrices.model = glm::mat4(1.0f);
+	drawStaticLayer(VP, sx, sy);
+	if(States.state==STATE_GAMEOVER)
+	{
 
-		glm::mat4 translateRectangle112 = glm::translate (glm::vec3(3, 3.7, 0));        // glTranslatef
-		glm::mat4 rotateRectangle112 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateRectangle112 * rotateRectangle112);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(pause);
+		addSprite(SPRITE_GAMEOVER, 0.6, -0.35, SPRITE_FRONT);
+		addSprite(SPRITE_RESTART, -0.6, -0.7, SPRITE_FRONT);
+	}
+	if(States.state==STATE_MENU)
+		addSprite(SPRITE_PLAY, 0, -0.35, SPRITE_FRONT);
+	if(States.runs(SYSTEM_FIELD)){
+		addSprite(States.state==STATE_PAUSED ? SPRITE_PLAY : SPRITE_PAUSE, 3, 3.7, SPRITE_FRONT);
 
 		if(leftmove!=1){
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateRectangle = glm::translate (glm::vec3(-3.15+position1, -3.3, 0));        // glTranslatef
+			glm::mat4 translateRectangle = glm::translate (glm::vec3(Level->red.x+position1, -3.3, 0));        // glTranslatef
 			glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 			Matrices.model *= (translateRectangle * rotateRectangle);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
 			draw3DObject(rectangle);
 		}
 		if(leftmove==1){
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateRectangle = glm::translate (glm::vec3(-3.15+position1, -3.3, 0));        // glTranslatef
+			glm::mat4 translateRectangle = glm::translate (glm::vec3(Level->red.x+position1, -3.3, 0));        // glTranslatef
 			glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 			Matrices.model *= (translateRectangle * rotateRectangle);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
 			draw3DObject(rectan);
 		}
 
 
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateCircle = glm::translate (glm::vec3(-3+position1, -2.8, 0));        // glTranslatef
+		glm::mat4 translateCircle = glm::translate (glm::vec3(Level->red.x+0.15+position1, -2.8, 0));        // glTranslatef
 		glm::mat4 rotateCircle = glm::rotate((float)(cirlce_rotation*M_PI/180.0f), glm::vec3(-1,0,0)); // rotate about vector (-1,1,1)
 		Matrices.model *= (translateCircle * rotateCircle);
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		draw3DObject(circle);
+		drawSdf(redWheel, MVP);
 
 
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateCircle1 = glm::translate (glm::vec3(-3+position1, -3.5, 0));        // glTranslatef
+		glm::mat4 translateCircle1 = glm::translate (glm::vec3(Level->red.x+0.15+position1, -3.5, 0));        // glTranslatef
 		glm::mat4 rotateCircle1 = glm::rotate((float)(cirlce_rotation1*M_PI/180.0f), glm::vec3(-1,0,0)); // rotate about vector (-1,1,1)
 		Matrices.model *= (translateCircle1 * rotateCircle1);
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		draw3DObject(circle1);
+		drawSdf(redWheel, MVP);
 		if(rightmove!=1){
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateRectangle1 = glm::translate (glm::vec3(2.85+position2, -3.3, 0));        // glTranslatef
+			glm::mat4 translateRectangle1 = glm::translate (glm::vec3(Level->green.x+position2, -3.3, 0));        // glTranslatef
 			glm::mat4 rotateRectangle1 = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 			Matrices.model *= (translateRectangle1 * rotateRectangle1);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
 			draw3DObject(rectangle1);
 		}
 		if(rightmove==1){
 			Matrices.model = glm::mat4(1.0f);
 
-			glm::mat4 translateRectangle1 = glm::translate (glm::vec3(2.85+position2, -3.3, 0));        // glTranslatef
+			glm::mat4 translateRectangle1 = glm::translate (glm::vec3(Level->green.x+position2, -3.3, 0));        // glTranslatef
 			glm::mat4 rotateRectangle1 = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 			Matrices.model *= (translateRectangle1 * rotateRectangle1);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
 			draw3DObject(rectang);
 		}
 
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateCircle2 = glm::translate (glm::vec3(3+position2, -2.8, 0));        // glTranslatef
+		glm::mat4 translateCircle2 = glm::translate (glm::vec3(Level->green.x+0.15+position2, -2.8, 0));        // glTranslatef
 		glm::mat4 rotateCircle2 = glm::rotate((float)(cirlce_rotation1*M_PI/180.0f), glm::vec3(-1,0,0)); // rotate about vector (-1,1,1)
 		Matrices.model *= (translateCircle2 * rotateCircle2);
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		draw3DObject(circle2);
+		drawSdf(greenWheel, MVP);
 
 
 		Matrices.model = glm::mat4(1.0f);
-		glm::mat4 translateCircle3 = glm::translate (glm::vec3(3+position2, -3.5, 0));        // glTranslatef
+		glm::mat4 translateCircle3 = glm::translate (glm::vec3(Level->green.x+0.15+position2, -3.5, 0));        // glTranslatef
 		glm::mat4 rotateCircle3 = glm::rotate((float)(cirlce_rotation1*M_PI/180.0f), glm::vec3(-1,0,0)); // rotate about vector (-1,1,1)
 		Matrices.model *= (translateCircle3 * rotateCircle3);
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		draw3DObject(circle3);
+		drawSdf(greenWheel, MVP);
 
 		/*	Matrices.model = glm::mat4(1.0f);
 
@@ -1277,26 +1662,18 @@ Matrices.model = glm::mat4(1.0f);
 			glm::mat4 rotateRectangle3 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 			Matrices.model *= (translateRectangle3 * rotateRectangle3);
 			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+			commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
 			draw3DObject(rectangle2);
 		 */
 		Matrices.model = glm::mat4(1.0f);
 
-		glm::mat4 translateRectangle4 = glm::translate (glm::vec3(-7.6, 0.65+position3, 0));        // glTranslatef
+		glm::mat4 translateRectangle4 = glm::translate (glm::vec3(Level->cannon.x, Level->cannon.y+position3, 0));        // glTranslatef
 		glm::mat4 rotateRectangle4 = glm::rotate((float)(position4*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 		Matrices.model *= (translateRectangle4 * rotateRectangle4);
 		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+		commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
 		draw3DObject(rectangle3);
 
-		Matrices.model = glm::mat4(1.0f);
-
-		glm::mat4 translateRectangle5 = glm::translate (glm::vec3(0, 0.6, 0));        // glTranslatef
-		glm::mat4 rotateRectangle5 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-		Matrices.model *= (translateRectangle5 * rotateRectangle5);
-		MVP = VP * Matrices.model;
-		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-		draw3DObject(line);
 
 		/*Matrices.model = glm::mat4(1.0f);
 
@@ -1304,242 +1681,138 @@ Matrices.model = glm::mat4(1.0f);
 		  glm::mat4 rotateRectangle6 =glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 		  Matrices.model *= (translateRectangle6 * rotateRectangle6);
 		  MVP = VP * Matrices.model;
-		  glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
+		  commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
 		  draw3DObject(line1);*/
 
 		if(flag==1){
-			Matrices.model = glm::mat4(1.0f);
-
-			glm::mat4 translateRectangle7 = glm::translate (glm::vec3(0, 0+pos[j], 0));        // glTranslatef
-			glm::mat4 rotateRectangle7 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-			Matrices.model *= (translateRectangle7 * rotateRectangle7);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(rect[j]);
+			int i=Bricks.count-1;
+			addBrick(Bricks.f(FIELD_X,i), Bricks.f(FIELD_Y,i), Bricks.i(FIELD_COLOR,i));
 		}
-		for(int i=0;i<=j;i++){
-			if(speed<1)
-				speed=1;
-			if(speed>3)
-				speed=3;
-			float c_time2=glfwGetTime();
-
-			if(c_time2-u_time2[i]>0.005 && !flagp){
-			pos[i]-=(0.02*speed);
-			u_time2[i]=glfwGetTime();
-		}
-			//if(pos[i]==-5.5 && random2[i]==0)
-			//printf("%f\n",pos[i]);
-			//if(4+pos[i] == -2) {
-			if( (abs(-3.15+position1-posx[i])<0.35) && pos[i]< -6.3 && random2[i]==1 && pos[i]>-7){
-				if(vis[i]==0)
-					score+=5;
-
-				vis[i]=1;
-			}
-			//		}
-			if(random2[i]==2 && abs(2.85+position2-posx[i])<0.35 && pos[i]<-6.3 && pos[i]> -7){
-				if(vis[i]==0)
-					score+=5;
-
-				vis[i]=1;
-			}
-			if( (abs(-3.15+position1-posx[i])<0.35) && pos[i]< -6.3 && random2[i]==0 && pos[i]>-7){
-				ex=1;
+		if(speed<Level->speed.min)
+			speed=Level->speed.min;
+		if(speed>Level->speed.max)
+			speed=Level->speed.max;
+
+		if(States.runs(SYSTEM_BRICKS)){
+			// Move and classify every brick in one vectorized sweep, then score the events
+			const LevelCatch &zone=Level->catchzone;
+			BrickSweep sweep;
+			double c_time2=instrumentNow();
+			sweep.fall=0;
+			if(c_time2-brick_fall_time>0.005){
+				sweep.fall=Level->speed.fall*speed;
+				brick_fall_time=c_time2;
 			}
-			//		}
-			if(random2[i]==0 && abs(2.85+position2-posx[i])<0.35 && pos[i]<-6.3 && pos[i]> -7){
-				ex=1;
+			sweep.red_x=Level->red.x+position1;
+			sweep.green_x=Level->green.x+position2;
+			sweep.halfwidth=zone.halfwidth;
+			sweep.top=zone.top;
+			sweep.bottom=zone.bottom;
+			sweep.miss=zone.miss;
+			sweepBricks(Jobs, Bricks, sweep, Events);
+			for(size_t e=0;e<Events.caught.size();e++){
+				score+=5;
+				caught++;
+				Bricks.i(FIELD_GONE,Events.caught[e])=1;
 			}
-
-
-			if(!vis[i]){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translateRectangle7 = glm::translate (glm::vec3(0, 0+pos[i], 0));        // glTranslatef
-				glm::mat4 rotateRectangle7 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translateRectangle7 * rotateRectangle7);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				/*if(pos[i]<0 && pos[i]>-0.2)
-				  q++;*/
-				if (pos[i] <0){
-
-					quex.push_back(posx[i]);
-					quey.push_back(pos[i]+4);
-					quei.push_back(i);
-
+			if(!Events.hazards.empty())
+				States.set(STATE_GAMEOVER);
+			for(size_t e=0;e<Events.misses.size();e++){
+				int i=Events.misses[e];
+				int32_t color=Bricks.i(FIELD_COLOR,i);
+				if(color==BRICK_RED){
+					exred++;
+					score-=3;
 				}
-
-				if(pos[i]<=-8){
-					if(random2[i]==1){
-						exred++;
-						score-=3;
-					}
-					if(random2[i]==2){
-						exgreen++;
-						score-=3;
-					}
-					if(exred==5 || exgreen==5)
-						ex=1;
-
-					vis[i]=1;
-					k++;
+				if(color==BRICK_GREEN){
+					exgreen++;
+					score-=3;
 				}
+				if(exred==5 || exgreen==5)
+					States.set(STATE_GAMEOVER);
 
-				for(int z=0;z<=j;z++){
-					for(int y=0;y<=press;y++){
-						if((abs(3.5+pos[z]-lasery[y])<0.2) && abs(posx[z]-laserx[y])<0.2 ){
-							position5[y]+=16;
-							if(random2[z]==0 && vis[z]==0)
-								score+=10;
-							else if(vis[z]==0)
-								score-=3;
-							vis[z]=1;
-
-						}}
-
-				}
-				if(pos[i]<=0)
-					draw3DObject(rect[i]);
+				Bricks.i(FIELD_GONE,i)=1;
+				k++;
+			}
+		}
 
+		if(States.runs(SYSTEM_COLLIDE)){
+			// Lasers against bricks, using the laser heads of the previous frame
+			collideLasers(Jobs, Bricks, Lasers, Hits);
+			for(size_t h=0;h<Hits.size();h++){
+				int z=Hits[h].brick, y=Hits[h].laser;
+				int32_t &gone=Bricks.i(FIELD_GONE,z);
+				Lasers.i(FIELD_GONE,y)=1;
+				if(Bricks.i(FIELD_COLOR,z)==BRICK_BLACK && gone==0)
+					score+=10;
+				else if(gone==0)
+					score-=3;
+				gone=1;
 			}
 		}
+		// Once the frame's events are scored, nothing refers to gone entities
+		removeGone();
+
+		for(int c=0;c<Bricks.chunkCount();c++){
+			const float *posx=Bricks.floats(c,FIELD_X), *pos=Bricks.floats(c,FIELD_Y);
+			const int32_t *color=Bricks.ints(c,FIELD_COLOR), *vis=Bricks.ints(c,FIELD_GONE);
+			for(int r=0;r<Bricks.rows(c);r++)
+				if(!vis[r] && pos[r]<=0)
+					addBrick(posx[r], pos[r], color[r]);
+		}
 
 
 		if(flag3==1){
-			for(int i=0;i<=press;i++){
-				float c_time1=glfwGetTime();
-				
-				if(c_time1-u_time1[i] > 0.005 && !flagp){				
-				position5[i]+=0.2;
-				u_time1[i]=glfwGetTime();
+			if(States.runs(SYSTEM_LASERS)){
+				double c_time1=instrumentNow();
+				float step=0;
+				if(c_time1-laser_step_time > 0.005){
+					step=0.2;
+					laser_step_time=c_time1;
+				}
+				advanceLasers(Jobs, Lasers, step, Level->mirrors, Level->mirror_count);
 			}
 
-				laserx[i]=xcollide[i]+position5[i]*cos(position6[i]*M_PI/180.0f);
-				lasery[i]=(ycollide[i]+position7[i])+position5[i]*sin(position6[i]*M_PI/180.0f);
-
-				Matrices.model = glm::mat4(1.0f);
-				glm::mat4 translateRectangle13 = glm::translate (glm::vec3(0, 0, 0));        // glTranslatef
-
-				glm::mat4 translateRectangle12 = glm::translate (glm::vec3(laserx[i], lasery[i], 0));        // glTranslatef
-				glm::mat4 rotateRectangle12 = glm::rotate((float)(position6[i]*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translateRectangle12 * rotateRectangle12*translateRectangle13);
-				MVP = VP * Matrices.model;	
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(laser[i]);
-				/*for(auto it=quei.begin();it!=quei.end();it++){ 
-				  vis[*it]=1;*/
-				laserx1[i]=xcollide[i]+(position5[i]+0.4)*cos(position6[i]*M_PI/180.0f);
-				lasery1[i]=(ycollide[i]+position7[i])+(position5[i]+0.4)*sin(position6[i]*M_PI/180.0f);
-				float p1x=-3+0.2*cos(45*M_PI/180);
-				float p1y=2-0.2*sin(45*M_PI/180);
-				float p2x=-3-0.9*cos(45*M_PI/180);
-				float p2y=2+0.9*sin(45*M_PI/180);
-				float q1x=-1.1-0.2*cos(45*M_PI/180);
-				float q1y=-1.4-0.2*sin(45*M_PI/180);
-				float q2x=-1.1+0.9*cos(45*M_PI/180);
-				float q2y=-1.4+0.9*sin(45*M_PI/180);
-				float r1x=5-0.2*cos(45*M_PI/180);
-				float r1y=-1.2-0.2*sin(45*M_PI/180);
-				float r2x=5+0.9*cos(45*M_PI/180);
-				float r2y=-1.2+0.9*sin(45*M_PI/180);
-				float s1x=5.5+0.2*cos(45*M_PI/180);
-				float s1y=2.5-0.2*sin(45*M_PI/180);
-				float s2x=5.5-0.9*cos(45*M_PI/180);
-				float s2y=2.5+0.9*sin(45*M_PI/180);
-				//check for mirror 1 collision
-				if((laserx[i]+lasery[i]+1.3)*(laserx1[i]+lasery1[i]+1.3)<0 && (p1y-lasery[i]-(tan(position6[i]*M_PI/180)*(p1x-laserx[i])))*(p2y-lasery[i]-(tan(position6[i]*M_PI/180)*(p2x-laserx[i])))<0){
-					position5[i]=0;
-					xcollide[i]=(laserx[i]+laserx1[i])/2;
-					ycollide[i]=(lasery[i]+lasery1[i])/2;
-					position7[i]=0;
-					position6[i]=2*135-position6[i];
-				}
-				//check for mirror 2 collision
-
-				if((laserx[i]-lasery[i]-0.1)*(laserx1[i]-lasery1[i]-0.1)<0 && (q1y-lasery[i]-(tan(position6[i]*M_PI/180)*(q1x-laserx[i])))*(q2y-lasery[i]-(tan(position6[i]*M_PI/180)*(q2x-laserx[i])))<0){
-					position5[i]=0;
-					xcollide[i]=(laserx[i]+laserx1[i])/2;
-					ycollide[i]=(lasery[i]+lasery1[i])/2;
-					position7[i]=0;
-					position6[i]=2*45-position6[i];
-				}
-				//check for mirror 3 collision
-				if((laserx[i]-lasery[i]-6)*(laserx1[i]-lasery1[i]-6)<0 && (r1y-lasery[i]-(tan(position6[i]*M_PI/180)*(r1x-laserx[i])))*(r2y-lasery[i]-(tan(position6[i]*M_PI/180)*(r2x-laserx[i])))<0){
-					position5[i]=0;
-					xcollide[i]=(laserx[i]+laserx1[i])/2;
-					ycollide[i]=(lasery[i]+lasery1[i])/2;
-					position7[i]=0;
-					position6[i]=2*45-position6[i];
-				}
-				// check for mirror 4 collision
-				if((laserx[i]+lasery[i]-7.8)*(laserx1[i]+lasery1[i]-7.8)<0 && (s1y-lasery[i]-(tan(position6[i]*M_PI/180)*(s1x-laserx[i])))*(s2y-lasery[i]-(tan(position6[i]*M_PI/180)*(s2x-laserx[i])))<0){
-					position5[i]=0;
-					xcollide[i]=(laserx[i]+laserx1[i])/2;
-					ycollide[i]=(lasery[i]+lasery1[i])/2;
-					position7[i]=0;
-					position6[i]=2*135-position6[i];
+			for(int c=0;c<Lasers.chunkCount();c++){
+				const float *laserx=Lasers.floats(c,FIELD_X0), *lasery=Lasers.floats(c,FIELD_Y0);
+				const float *laserx1=Lasers.floats(c,FIELD_X1), *lasery1=Lasers.floats(c,FIELD_Y1);
+				for(int i=0;i<Lasers.rows(c);i++){
+					// the quad is a bit longer and wider than the segment itself
+					if(!onScreen(min(laserx[i],laserx1[i])-0.2f, min(lasery[i],lasery1[i])-0.2f,
+								max(laserx[i],laserx1[i])+0.2f, max(lasery[i],lasery1[i])+0.2f))
+						continue;
+					// orient by the segment just advanced, before any bounce turned it
+					float ux=(laserx1[i]-laserx[i])/LASER_LENGTH, uy=(lasery1[i]-lasery[i])/LASER_LENGTH;
+					glm::mat4 rotateRectangle12 = glm::mat4(1.0f);
+					rotateRectangle12[0][0]=ux; rotateRectangle12[0][1]=uy;
+					rotateRectangle12[1][0]=-uy; rotateRectangle12[1][1]=ux;
+					Matrices.model = glm::translate (glm::vec3(laserx[i], lasery[i], 0)) * rotateRectangle12;
+					MVP = VP * Matrices.model;	
+					commands().uniformMatrix4(Matrices.MatrixID, &MVP[0][0]);
+					draw3DObject(laser);
 				}
 			}
 			}
 
 
 
-			Matrices.model = glm::mat4(1.0f);
-
-			glm::mat4 translateRectangle8 = glm::translate (glm::vec3(5.5, 2.5, 0));        // glTranslatef
-			glm::mat4 rotateRectangle8 = glm::rotate((float)(135*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-			Matrices.model *= (translateRectangle8 * rotateRectangle8);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(rectangle4);
-
-			Matrices.model = glm::mat4(1.0f);
-
-			glm::mat4 translateRectangle9 = glm::translate (glm::vec3(5, -1.2, 0));        // glTranslatef
-			glm::mat4 rotateRectangle9 = glm::rotate((float)(45*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-			Matrices.model *= (translateRectangle9 * rotateRectangle9);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(rectangle5);
-
-			Matrices.model = glm::mat4(1.0f);
-
-			glm::mat4 translateRectangle10 = glm::translate (glm::vec3(-3, 2, 0));        // glTranslatef
-			glm::mat4 rotateRectangle10 = glm::rotate((float)(135*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-			Matrices.model *= (translateRectangle10 * rotateRectangle10);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(rectangle6);
-
-			Matrices.model = glm::mat4(1.0f);
-
-			glm::mat4 translateRectangle11 = glm::translate (glm::vec3(-1.1, -1.4, 0));        // glTranslatef
-			glm::mat4 rotateRectangle11 = glm::rotate((float)(45*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-			Matrices.model *= (translateRectangle11 * rotateRectangle11);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(rectangle7);
 			if(moverifle!=1){
 				Matrices.model = glm::mat4(1.0f);
 
-				glm::mat4 translatecircle4 = glm::translate (glm::vec3(-8, 0.65+position3, 0));        // glTranslatef
+				glm::mat4 translatecircle4 = glm::translate (glm::vec3(Level->cannon.x-0.4, Level->cannon.y+position3, 0));        // glTranslatef
 				glm::mat4 rotatecircle4 = glm::rotate((float)(position4*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 				Matrices.model *= (translatecircle4 * rotatecircle4);
 				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(circle4);
+				drawSdf(cannonBase, MVP);
 			}
 			if(moverifle==1){
 				Matrices.model = glm::mat4(1.0f);
 
-				glm::mat4 translatecircle4 = glm::translate (glm::vec3(-8, 0.65+position3, 0));        // glTranslatef
+				glm::mat4 translatecircle4 = glm::translate (glm::vec3(Level->cannon.x-0.4, Level->cannon.y+position3, 0));        // glTranslatef
 				glm::mat4 rotatecircle4 = glm::rotate((float)(position4*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 				Matrices.model *= (translatecircle4 * rotatecircle4);
 				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(circle41);
+				drawSdf(cannonBaseMoving, MVP);
 				//7 segment display
 			}
 		}
@@ -1547,327 +1820,15 @@ Matrices.model = glm::mat4(1.0f);
 			dig=0;
 
 		for(int a=dig;a>=0;a--){
-			int p=score1%10;
-			if(p==0||p==4||p==5||p==6||p==8||p==9){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment1 = glm::translate (glm::vec3(6.5+a*0.5-sx, 3.4+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment1 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment1 * rotatesegment1);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(segment[0]);
-			}
-			if(p==0||p==2||p==6||p==8){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment2 = glm::translate (glm::vec3(6.5+a*0.5-sx, 3.21+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment2 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment2 * rotatesegment2);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(segment[1]);
-			}
-			if(p==0||p==2||p==3||p==5||p==6||p==8){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment3 = glm::translate (glm::vec3(6.49+a*0.5-sx, 3.2+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment3 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment3 * rotatesegment3);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(segment[2]);
-			}
-			if(p==0||p==1||p==3||p==4||p==5||p==6||p==7||p==8||p==9){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment4 = glm::translate (glm::vec3(6.73+a*0.5-sx, 3.21+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment4 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment4 * rotatesegment4);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(segment[3]);
-			}
-			if(p==0||p==1||p==2||p==3||p==4||p==7||p==8||p==9){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment5 = glm::translate (glm::vec3(6.73+a*0.5-sx, 3.4+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment5 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment5 * rotatesegment5);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(segment[4]);
-			}
-			if(p==0||p==2||p==3||p==5||p==6||p==7||p==8||p==9){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment6 = glm::translate (glm::vec3(6.5+a*0.5-sx, 3.55+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment6 = glm::rotate((float)(	0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment6 * rotatesegment6);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(segment[5]);
-			}
-			if(p==8 ||p==2||p==5||p==3||p==4||p==6||p==9){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment7 = glm::translate (glm::vec3(6.49+a*0.5-sx, 3.37+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment7 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment7 * rotatesegment7);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(segment[6]);
-			}
+			addSprite(SpriteId(SPRITE_DIGIT0+score1%10), 6.5+a*0.5-sx, 3.5-sy, SPRITE_BACK);
 			score1=score1/10;
 		}
-
-		for(int c=0;c<5;c++){
-
-			Matrices.model = glm::mat4(1.0f);
-
-			glm::mat4 translatesegment8 = glm::translate (glm::vec3(3.5+c*0.4+0.7-sx, 3.4+0.3-sy, 0));        // glTranslatef
-			glm::mat4 rotatesegment8 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-			Matrices.model *= (translatesegment8 * rotatesegment8);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(scoredis[0]);
-			if(c!=0){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment9 = glm::translate (glm::vec3(3.5+c*0.4+0.7-sx, 3.21+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment9 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment9 * rotatesegment9);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(scoredis[1]);
-			}
-			if(c!=3){
-
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment10 = glm::translate (glm::vec3(3.49+c*0.4+0.7-sx, 3.2+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment10 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment10 * rotatesegment10);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(scoredis[2]);
-			}
-			if(c==0 ||c==2||c==3){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment11 = glm::translate (glm::vec3(3.7+c*0.4+0.7-sx, 3.21+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment11 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment11 * rotatesegment11);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(scoredis[3]);
-			}
-			if(c==2||c==3){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment12 = glm::translate (glm::vec3(3.7+c*0.4+0.7-sx, 3.4+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment12 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment12 * rotatesegment12);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(scoredis[4]);
-			}
-
-			Matrices.model = glm::mat4(1.0f);
-
-			glm::mat4 translatesegment13 = glm::translate (glm::vec3(3.5+c*0.4+0.7-sx, 3.55+0.3-sy, 0));        // glTranslatef
-			glm::mat4 rotatesegment13 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-			Matrices.model *= (translatesegment13 * rotatesegment13);
-			MVP = VP * Matrices.model;
-			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-			draw3DObject(scoredis[5]);
-
-			if(c==0 || c==3||c==4){
-				Matrices.model = glm::mat4(1.0f);
-
-				glm::mat4 translatesegment14 = glm::translate (glm::vec3(3.5+c*0.4+0.7-sx, 3.37+0.3-sy, 0));        // glTranslatef
-				glm::mat4 rotatesegment14 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-				Matrices.model *= (translatesegment14 * rotatesegment14);
-				MVP = VP * Matrices.model;
-				glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-				draw3DObject(scoredis[6]);
-			}	
+		if(States.state!=STATE_GAMEOVER){
+			int le=mul+1;
+			if(le<=9)
+				addSprite(SpriteId(SPRITE_DIGIT0+le), -5.1, 3.5, SPRITE_BACK);
 		}
-		if(ex==0){
-		int le=mul+1;
-			
-			for(int c=0;c<6;c++){
-				if(c==5)
-					c=6;
-
-				if(c==0||c==1||c==3||c==4 ||c==2 ){
-					int angle=90;
-					float shift=0;
-					if(c==2)
-						angle=120;
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment15 = glm::translate (glm::vec3(-7.5+c*0.4, 3.4+0.3, 0));
-					// glTranslatef
-					glm::mat4 rotatesegment15 = glm::rotate((float)(angle*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment15 * rotatesegment15);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[0]);
-				}
-
-				if(c==0||c==1||c==3||c==4||c==2){
-					int angle=90;
-					float shift=0;
-					if(c==2){
-						angle=120;
-						shift=0.1;
-					}
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment16 = glm::translate (glm::vec3(-7.5+c*0.4+shift, 3.21+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment16 = glm::rotate((float)(angle*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment16 * rotatesegment16);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[1]);
-				}
-				if(c==0||c==1||c==3||c==4){
-					Matrices.model = glm::mat4(1.0f);
-
-
-					glm::mat4 translatesegment17 = glm::translate (glm::vec3(-7.51+c*0.4, 3.2+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment17 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment17 * rotatesegment17);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[2]);
-				}
-				if(c==2){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment18 = glm::translate (glm::vec3(-7.34+c*0.4, 3.21+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment18 = glm::rotate((float)(70*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment18 * rotatesegment18);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[3]);
-				}
-				if(c==2){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment19 = glm::translate (glm::vec3(-7.28+c*0.4, 3.4+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment19 = glm::rotate((float)(70*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment19 * rotatesegment19);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[4]);
-				}
-				if(c==1||c==3){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment20 = glm::translate (glm::vec3(-7.51+c*0.4, 3.55+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment20 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment20 * rotatesegment20);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[5]);
-				}
-				if(c==1||c==3){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment21 = glm::translate (glm::vec3(-7.51+c*0.4, 3.37+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment21 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment21 * rotatesegment21);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[6]);
-				}
-
-
-
-				//level no
-				int p=le;
-				if(c==6 &&(p==0||p==4||p==5||p==6||p==8||p==9)){
-					int angle=90;
-
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment15 = glm::translate (glm::vec3(-7.5+c*0.4, 3.4+0.3, 0));
-					// glTranslatef
-					glm::mat4 rotatesegment15 = glm::rotate((float)(angle*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment15 * rotatesegment15);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[0]);
-				}
-
-				if(c==6 &&(p==0||p==2||p==6||p==8)){
-
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment16 = glm::translate (glm::vec3(-7.5+c*0.4, 3.21+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment16 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment16 * rotatesegment16);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[1]);
-				}
-				if(c==6 && (p==2||p==3||p==5||p==6||p==8)){
-					Matrices.model = glm::mat4(1.0f);
-
-
-					glm::mat4 translatesegment17 = glm::translate (glm::vec3(-7.51+c*0.4, 3.2+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment17 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment17 * rotatesegment17);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[2]);
-				}
-				if(c==6 && (p==1||p==3||p==4||p==5||p==6||p==7||p==8||p==9)){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment18 = glm::translate (glm::vec3(-7.28+c*0.4, 3.21+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment18 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment18 * rotatesegment18);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[3]);
-				}
-				if(c==6 && (p==1||p==2||p==3||p==4||p==7||p==8||p==9)){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment19 = glm::translate (glm::vec3(-7.28+c*0.4, 3.4+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment19 = glm::rotate((float)(90*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment19 * rotatesegment19);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[4]);
-				}
-				if(c==6 && (p==2||p==3||p==5||p==6||p==7||p==8||p==9)){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment20 = glm::translate (glm::vec3(-7.51+c*0.4, 3.55+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment20 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment20 * rotatesegment20);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[5]);
-				}
-				if(c==6 && (p==8 ||p==2||p==5||p==3||p==4||p==6||p==9)){
-					Matrices.model = glm::mat4(1.0f);
-
-					glm::mat4 translatesegment21 = glm::translate (glm::vec3(-7.51+c*0.4, 3.37+0.3, 0));        // glTranslatef
-					glm::mat4 rotatesegment21 = glm::rotate((float)(0*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-					Matrices.model *= (translatesegment21 * rotatesegment21);
-					MVP = VP * Matrices.model;
-					glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-					draw3DObject(level[6]);
-				}
-
-			}
-
-		}		
+		drawSprites(VP);
 		float increments = 1;
 
 		//printf("%d\n",score);
@@ -1876,72 +1837,93 @@ Matrices.model = glm::mat4(1.0f);
 		//rectangle_rotation = rectangle_rotation + increments*rectangle_rot_dir*rectangle_rot_status;
 	}
 
-	/* Initialise glfw window, I/O callbacks and the renderer to use */
-	/* Nothing to Edit here */
-	GLFWwindow* initGLFW (int width, int height)
+	/* Open the platform's window and context and route its events to the game */
+	bool initWindow (Platform *platform, int width, int height)
 	{
-		GLFWwindow* window; // window desciptor/handle
-
-		glfwSetErrorCallback(error_callback);
-		if (!glfwInit()) {
-			//        exit(EXIT_FAILURE);
+		if (!platform->open(width, height, "Sample OpenGL 3.3 Application")) {
+			fprintf(stderr, "%s: cannot open a window with an OpenGL 3.3 context\n", platform->name());
+			return false;
 		}
 
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-		window = glfwCreateWindow(width, height, "Sample OpenGL 3.3 Application", NULL, NULL);
-
-		if (!window) {
-			glfwTerminate();
-			//        exit(EXIT_FAILURE);
+		// SAMPLE2D_GLTRACE=count|time|trace-file wraps the GL entry points
+		const char *gltrace = getenv("SAMPLE2D_GLTRACE");
+		if (gltrace) {
+			bool count_only = !strcmp(gltrace, "count");
+			bool to_file = !count_only && strcmp(gltrace, "time");
+			glTraceInstall(!count_only, to_file ? gltrace : NULL);
 		}
 
-		glfwMakeContextCurrent(window);
-		gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
-		glfwSwapInterval( 1 );
-
-		/* --- register callbacks with GLFW --- */
-
-		/* Register function to handle window resizes */
-		/* With Retina display on Mac OS X GLFW's FramebufferSize
-		   is different from WindowSize */
-		glfwSetFramebufferSizeCallback(window, reshapeWindow);
-		glfwSetWindowSizeCallback(window, reshapeWindow);
-
-		/* Register function to handle window close */
-		glfwSetWindowCloseCallback(window, quit);
-
-		/* Register function to handle keyboard input */
-		glfwSetKeyCallback(window, keyboard);      // general keyboard input
-		glfwSetCharCallback(window, keyboardChar);  // simpler specific character handling
-
-		/* Register function to handle mouse click */
-		glfwSetMouseButtonCallback(window, mouseButton);  // mouse button clicks
-		glfwSetScrollCallback(window, mousezoom);
-
-		return window;
+		// Adaptive vsync where the driver has it: a late frame tears instead of
+		// waiting a whole extra refresh. SAMPLE2D_VSYNC=on|off overrides.
+		const char *vsync = getenv("SAMPLE2D_VSYNC");
+		const char *interval;
+		if (vsync && !strcmp(vsync, "off")) {
+			interval = platform->swapInterval( 0 ) ? "off" : "driver default";
+			Pacer.enabled = false;	// no vblank to pace against
+		}
+		else if (!(vsync && !strcmp(vsync, "on")) && platform->swapInterval( -1 ))
+			interval = "adaptive";
+		else
+			interval = platform->swapInterval( 1 ) ? "vsync" : "driver default";
+		instrumentNote("swap interval: %s", interval);
+
+		/* --- register callbacks with the platform --- */
+		PlatformCallbacks &on = platform->on;
+		on.reshape = reshapeWindow;
+		on.refresh = refreshWindow;
+		on.close = quit;
+		on.key = keyboard;      // general keyboard input
+		on.character = keyboardChar;  // simpler specific character handling
+		on.mouseButton = mouseButton;  // mouse button clicks
+		on.scroll = mousezoom;
+		return true;
 	}
 
+	const char *renderer_name = "";
+
 	/* Initialize the OpenGL rendering properties */
 	/* Add all the models to be created here */
-	void initGL (GLFWwindow* window, int width, int height)
+	void initGL (int width, int height)
 	{
 		/* Objects should be created before any other gl function and shaders */
 		// Create the models
+		double start = instrumentNow();
 		createTriangle (); // Generate the VAO, VBOs, vertices data & copy into the array buffer
+		instrumentPhase("triangles", instrumentNow() - start);
+		start = instrumentNow();
 		createRectangle ();
+		instrumentPhase("rectangles", instrumentNow() - start);
+		start = instrumentNow();
 		createCircle();
-		createobjects();
+		instrumentPhase("circles", instrumentNow() - start);
+		start = instrumentNow();
+		createSprites();
+		createStaticLayer();
+		instrumentPhase("sprites", instrumentNow() - start);
 		// Create and compile our GLSL program from the shaders
+#ifdef EMBED_SHADERS
+		programID = LoadProgram( Sample_GL_vert, Sample_GL_frag, "Sample_GL" );
+		spriteProgram = LoadProgram( Sprite_vert, Sprite_frag, "Sprite" );
+		sdfProgram = LoadProgram( Sdf_vert, Sdf_frag, "Sdf" );
+#else
 		programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
+		spriteProgram = LoadShaders( "Sprite.vert", "Sprite.frag" );
+		sdfProgram = LoadShaders( "Sdf.vert", "Sdf.frag" );
+#endif
 		// Get a handle for our "MVP" uniform
 		Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+		spriteMVP = glGetUniformLocation(spriteProgram, "MVP");
+		SdfUniforms.MVP = glGetUniformLocation(sdfProgram, "MVP");
+		SdfUniforms.halfSize = glGetUniformLocation(sdfProgram, "halfSize");
+		SdfUniforms.corner = glGetUniformLocation(sdfProgram, "corner");
+		SdfUniforms.ring = glGetUniformLocation(sdfProgram, "ring");
+		SdfUniforms.color = glGetUniformLocation(sdfProgram, "shapeColor");
+		glUseProgram(spriteProgram);
+		glUniform1i(glGetUniformLocation(spriteProgram, "atlas"), 0);
 
 
-		reshapeWindow (window, width, height);
+		start = instrumentNow();
+		reshapeWindow (width, height);
 
 		// Background color of the scene
 		glClearColor (  1.0f, 1.0f, 1.0f, 0.0f); // R, G, B, A
@@ -1950,9 +1932,150 @@ Matrices.model = glm::mat4(1.0f);
 		glEnable (GL_DEPTH_TEST);
 
 		cout << "VENDOR: " << glGetString(GL_VENDOR) << endl;
-		cout << "RENDERER: " << glGetString(GL_RENDERER) << endl;
+		renderer_name = (const char*)glGetString(GL_RENDERER);
+		cout << "RENDERER: " << renderer_name << endl;
 		cout << "VERSION: " << glGetString(GL_VERSION) << endl;
 		cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+		instrumentPhase("gl state", instrumentNow() - start);
+	}
+
+	/* Benchmark scenes: canned stress states for the real draw() path, run
+	   for a fixed number of frames without vsync, offscreen by default */
+	struct Scene {
+		const char *name;
+		void (*setup) ();
+		void (*frame) (int n);	// per-frame changes, may be NULL
+	};
+
+	// Bricks parked above the catch zone so nothing scores while they sit still
+	void sceneBricks ()
+	{
+		States.set(STATE_PAUSED);
+		Bricks.resize(10000);
+		for(int i=0;i<Bricks.count;i++){
+			rollBrick(i);
+			Bricks.f(FIELD_Y,i)=(Level->catchzone.top+0.1f)*(rand()/(float)RAND_MAX);
+		}
+	}
+
+	// Lasers scattered around the mirrors in every direction
+	void sceneLasers ()
+	{
+		for(int i=0;i<2000;i++){
+			const LevelMirror &mirror=Level->mirrors[i%max(1u,Level->mirror_count)];
+			float angle=(rand()%360)*M_PI/180.0f;
+			int l=Lasers.add();
+			Lasers.f(FIELD_DX,l)=cos(angle);
+			Lasers.f(FIELD_DY,l)=sin(angle);
+			Lasers.f(FIELD_X,l)=(Level->mirror_count ? mirror.x : 0)+(rand()%200)/100.0f-1;
+			Lasers.f(FIELD_Y,l)=(Level->mirror_count ? mirror.y : 0)+(rand()%200)/100.0f-1;
+		}
+		flag3=1;
+	}
+
+	void scenePanSetup ()
+	{
+		sceneBricks();
+		zoom=2;
+	}
+
+	// Full zoom, panning across the whole field every few dozen frames
+	void scenePan (int n)
+	{
+		xpos=4*sin(n*0.3f);
+		ypos=2*cos(n*0.5f);
+		pan();
+	}
+
+	const Scene Scenes[] = {
+		{ "bricks", sceneBricks, NULL },
+		{ "lasers", sceneLasers, NULL },
+		{ "pan", scenePanSetup, scenePan },
+	};
+
+	const Scene *findScene (const char *name)
+	{
+		for(size_t i=0;i<sizeof Scenes/sizeof Scenes[0];i++)
+			if(!strcmp(Scenes[i].name, name))
+				return &Scenes[i];
+		return NULL;
+	}
+
+	/* Draw 'frames' frames of the scene and print one JSON line of results */
+	void runScene (const Scene *scene, int frames)
+	{
+		srand(1);
+		Spawner.reset(1);
+		States.set(STATE_PLAYING);
+		scene->setup();
+		if(!glTraceActive()){
+			// the pointers are swapped under the render thread: let it go idle first
+			Renderer.finish();
+			glTraceInstall(false, NULL);	// counting only: cheap enough not to skew submit times
+		}
+		vector<double> submit;
+		long calls=draw_calls, gl_calls=glTraceCalls();
+		long drawn=cull_drawn, culled=cull_culled;
+		FrameTiming done;
+		double poll=0;
+		double start=instrumentNow();
+		for(int n=0;n<frames;n++){
+			if(scene->frame)
+				scene->frame(n);
+			double t=instrumentNow();
+			States.beginFrame();
+			draw();
+			States.endFrame();
+			submit.push_back(instrumentNow()-t);
+			Renderer.submit(done);
+			t=instrumentNow();
+			Window->pollEvents();
+			poll+=instrumentNow()-t;
+		}
+		Renderer.finish();
+		double total=instrumentNow()-start;
+		double sum=0;
+		for(size_t i=0;i<submit.size();i++)
+			sum+=submit[i];
+		sort(submit.begin(), submit.end());
+		GameState state=States.state;
+		printf("{ \"scene\": \"%s\", \"platform\": \"%s\", \"renderer\": \"%s\", \"state\": \"%s\", \"frames\": %d, \"fps\": %.1f, "
+				"\"submit_ms_mean\": %.3f, \"cpu_ms_mean\": %.3f, \"submit_ms_p95\": %.3f, \"poll_ms_mean\": %.3f, "
+				"\"draw_calls_per_frame\": %.1f, \"gl_calls_per_frame\": %.1f, "
+				"\"drawn_per_frame\": %.1f, \"culled_per_frame\": %.1f }\n",
+				scene->name, Window->name(), renderer_name, gameStateName(state), frames, frames/total,
+				sum*1e3/frames, States.cpu(state)*1e3/max(States.frames(state), 1L), submit[submit.size()*95/100]*1e3, poll*1e3/frames, (draw_calls-calls)/(double)frames,
+				(glTraceCalls()-gl_calls)/(double)frames,
+				(cull_drawn-drawn)/(double)frames, (cull_culled-culled)/(double)frames);
+	}
+
+	/* Replay a capture written with SAMPLE2D_CAPTURE. Its frames name the
+	   objects of the recording process, which initGL() has just recreated */
+	int runReplay (const char *path)
+	{
+		FILE *in=fopen(path, "rb");
+		if(!in || !captureCheck(in)){
+			fprintf(stderr, "%s: not a sample2D capture\n", path);
+			if(in)
+				fclose(in);
+			return 1;
+		}
+		FrameTiming done;
+		long bytes=0;
+		int frames=0;
+		double start=instrumentNow();
+		while(captureRead(in, *Renderer.recording)){
+			bytes+=Renderer.recording->used;
+			Renderer.submit(done);
+			Window->pollEvents();
+			frames++;
+		}
+		Renderer.finish();
+		double total=instrumentNow()-start;
+		fclose(in);
+		printf("{ \"replay\": \"%s\", \"platform\": \"%s\", \"renderer\": \"%s\", \"frames\": %d, \"fps\": %.1f, \"bytes_per_frame\": %.0f }\n",
+				path, Window->name(), renderer_name, frames, frames/total, bytes/(double)max(frames, 1));
+		return 0;
 	}
 
 	int main (int argc, char** argv)
@@ -1960,28 +2083,143 @@ Matrices.model = glm::mat4(1.0f);
 		int width = 1500;
 		int height = 800;
 
-		GLFWwindow* window = initGLFW(width, height);
+		double start = instrumentNow();
+		// --scene=NAME [--frames=N] runs a benchmark scene instead of the game
+		const Scene *scene = NULL;
+		int frames = 300, level_args = 0;
+		char name[32];
+		// --replay=FILE plays back a capture instead
+		const char *replay_path = NULL;
+		// --platform=NAME picks the window system backend
+		const char *platform = NULL;
+		// Levels given on the command line, else the ones built next to the game
+		for (int a=1; a<argc; a++)
+			if (sscanf(argv[a], "--scene=%31s", name) == 1) {
+				if (!(scene = findScene(name))) {
+					fprintf(stderr, "%s: unknown scene '%s' (bricks, lasers, pan)\n", argv[0], name);
+					return 1;
+				}
+			}
+			else if (sscanf(argv[a], "--frames=%d", &frames) == 1)
+				continue;
+			else if (strncmp(argv[a], "--replay=", 9) == 0)
+				replay_path = argv[a] + 9;
+			else if (strncmp(argv[a], "--platform=", 11) == 0)
+				platform = argv[a] + 11;
+			else {
+				level_args++;
+				if (const LevelData *level = levelMap(argv[a]))
+					Levels.push_back(level);
+				else
+					fprintf(stderr, "%s: not a valid level file\n", argv[a]);
+			}
+		if (level_args == 0) {
+			const char *defaults[] = { "levels/default.lvl", "levels/crossfire.lvl" };
+			for (int a=0; a<2; a++)
+				if (const LevelData *level = levelMap(defaults[a]))
+					Levels.push_back(level);
+		}
+		if (Levels.empty())
+			Levels.push_back(levelDefault());
+		Level = Levels[0];
+		instrumentPhase("levels", instrumentNow() - start);
+		instrumentNote("levels: %d mapped, playing '%s'", (int)Levels.size(), Level->name);
+		instrumentNote("simulation kernels: %s", simulateTarget());
+
+		// SAMPLE2D_THREADS=N caps the job system, 1 keeps every kernel on this thread
+		const char *threads = getenv("SAMPLE2D_THREADS");
+		Jobs.start(threads ? atoi(threads) : 0);
+		instrumentNote("job system: %d threads", Jobs.threads());
+
+		// A different game every run unless SAMPLE2D_SEED asks for a particular one
+		const char *seed = getenv("SAMPLE2D_SEED");
+		Spawner.reset(seed ? strtoull(seed, NULL, 0) : (uint64_t)time(NULL));
+		instrumentNote("spawn seed: %llu", (unsigned long long)Spawner.seed);
+
+		// SAMPLE2D_TELEMETRY_FORMAT=binary switches from the line protocol
+		const char *telemetry = getenv("SAMPLE2D_TELEMETRY");
+		const char *telemetry_format = getenv("SAMPLE2D_TELEMETRY_FORMAT");
+		if (telemetry)
+			Telemetry.open(telemetry, telemetry_format && !strcmp(telemetry_format, "binary")
+					? TELEMETRY_BINARY : TELEMETRY_LINE, TELEMETRY_INTERVAL);
+
+		bool offscreen = scene || replay_path;
+		if (offscreen) {
+			// Reproducible without a GPU: Mesa's llvmpipe unless the caller chose otherwise
+			setenv("LIBGL_ALWAYS_SOFTWARE", "1", 0);
+			setenv("SAMPLE2D_VSYNC", "off", 1);
+		}
+
+		if (!platform)
+			platform = platformDefault(!offscreen);
+		if (!platform || !(Window = platformCreate(platform))) {
+			fprintf(stderr, "%s: unknown platform '%s' (built with: %s)\n", argv[0],
+					platform ? platform : "", platformList());
+			return 1;
+		}
+		start = instrumentNow();
+		if (!initWindow(Window, width, height))
+			return 1;
+		instrumentPhase("window+context", instrumentNow() - start);
+		instrumentNote("platform: %s", Window->name());
+
+		initGL (width, height);
+
+		// SAMPLE2D_RENDER_THREAD=0 replays each frame inline on this thread
+		const char *threading = getenv("SAMPLE2D_RENDER_THREAD");
+		const char *capture = getenv("SAMPLE2D_CAPTURE");
+		if (capture && !replay_path) {
+			Renderer.capture = fopen(capture, "wb");
+			if (!Renderer.capture || !captureBegin(Renderer.capture))
+				fprintf(stderr, "%s: cannot write capture\n", capture);
+		}
+		Renderer.start(Window, !(threading && strcmp(threading, "0") == 0));
 
-		initGL (window, width, height);
+		if (offscreen) {
+			int status = 0;
+			if (scene)
+				runScene(scene, max(frames, 1));
+			else
+				status = runReplay(replay_path);
+			Renderer.stop();
+			if (Renderer.capture)
+				fclose(Renderer.capture);
+			Resources.release();
+			levelUnmapAll();
+			Window->close();
+			return status;
+		}
 
 
-		double last_update_time = glfwGetTime(), current_time,current,last_update=glfwGetTime();
+		double last_update_time = instrumentNow(), current_time,current,last_update=instrumentNow();
 
 		/* Draw in loop */
-		while (!glfwWindowShouldClose(window)) {
+		bool first_frame = true;
+		double last_frame = -1;	// when the previous drawn frame was submitted, for telemetry
+		while (!Window->shouldClose()) {
+
+			// Nothing moves outside of play: sleep until
+			// input, a resize or an expose asks for a new frame
+			if (simulationIdle() && !frame_dirty) {
+				Window->waitEvents(1.0);
+				idle_waits++;
+				Pacer.resync();
+				last_frame = -1;	// time spent idle is not frame time
+				continue;
+			}
+			frame_dirty = false;
+			frames_drawn++;
 
-			// OpenGL Draw commands
-
-			draw();
-			// Swap Frame Buffer in double buffering
-			glfwSwapBuffers(window);
+			// Sample input as late as possible, just early enough to make the next vblank
+			Pacer.waitForInput();
 
+			States.beginFrame();
 			// Poll for Keyboard and mouse events
-			glfwPollEvents();
+			Window->pollEvents();
 			//flag2=1;
 			// Control based on time (Time based transformation like 5 degrees rotation every 0.5s)
-			current_time = glfwGetTime(); // Time in seconds
-			current = glfwGetTime(); // Time in seconds
+			current_time = instrumentNow(); // Time in seconds
+			current = instrumentNow(); // Time in seconds
 			if ((current - last_update) > 0.5) { // atleast 0.5s elapsed since last frame
 				last_update = current;
 				flag2=1;
@@ -1991,33 +2229,55 @@ Matrices.model = glm::mat4(1.0f);
 
 			if((current_time - last_update_time) >0.005)
 			{
-				if(lb==1)
-					position1+=0.05;
-				if(lb==-1)
-					position1-=0.05;
-				if(rb==1)
-					position2+=0.05;
-				if(rb==-1)
-					position2-=0.05;
-				if(gg==1)
-					position3+=0.05;
-				if(gg==-1)
-					position3-=0.05;
+				if(States.runs(SYSTEM_CONTROL)){
+					if(lb==1)
+						position1+=0.05;
+					if(lb==-1)
+						position1-=0.05;
+					if(rb==1)
+						position2+=0.05;
+					if(rb==-1)
+						position2-=0.05;
+					if(gg==1)
+						position3+=0.05;
+					if(gg==-1)
+						position3-=0.05;
+				}
 				if(lmouse==1 || rmouse==1)
-					drag(window);
+					drag();
 			}
-			if ((current_time - last_update_time) >= 1.6/speed && !flagp) { // atleast 0.5s elapsed since last frame
+			if ((current_time - last_update_time) >= Level->speed.interval/speed && States.runs(SYSTEM_SPAWN)) { // atleast 0.5s elapsed since last frame
 				// do something every 0.5 seconds ..
 				last_update_time = current_time;
 				flag=1;
-				j++;
+				rollBrick(Bricks.add());
 			}
 
 			flag=0;
+
+			// OpenGL Draw commands
+
+			if (first_frame)
+				start = instrumentNow();
+			draw();
+
+			// Hand the frame to the render thread, which replays and swaps it
+			commands().input_time = Pacer.input_time;
+			FrameTiming done;
+			if (Renderer.submit(done))
+				Pacer.completed(done.input, done.swap, done.present);
+			if (States.runs(SYSTEM_REWIND))
+				recordState();
+			States.endFrame();
+			double now = instrumentNow();
+			if (Telemetry.active() && last_frame >= 0)
+				sendTelemetry(now - last_frame);
+			last_frame = now;
+			if (first_frame) {
+				instrumentPhase("first frame", instrumentNow() - start);
+				instrumentFirstFrame();
+				first_frame = false;
+			}
 		}
-		glfwTerminate();
-		quex.clear();
-		quey.clear();
-		quei.clear();
-		//    exit(EXIT_SUCCESS);
+		quit();
 	}
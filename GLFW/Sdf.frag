@@ -0,0 +1,27 @@
+#version 330 core
+
+in vec2 local;
+
+// Rounded rectangle with the given half extent and corner radius; a circle
+// is a square whose corner radius equals its half size. A ring width > 0
+// keeps only a band of that width inside the outline.
+uniform vec2 halfSize;
+uniform float corner;
+uniform float ring;
+uniform vec3 shapeColor;
+
+out vec4 color;
+
+void main()
+{
+    vec2 q = abs(local) - halfSize + corner;
+    float d = length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - corner;
+    if (ring > 0.0)
+        d = abs(d + 0.5*ring) - 0.5*ring;
+
+    // Distance to coverage over one pixel's footprint
+    float alpha = clamp(0.5 - d/fwidth(d), 0.0, 1.0);
+    if (alpha <= 0.0)
+        discard;
+    color = vec4(shapeColor, alpha);
+}
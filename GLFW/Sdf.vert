@@ -0,0 +1,19 @@
+#version 330 core
+
+// input data : corners of the unit quad (-1..1), stretched over the shape
+layout (location = 0) in vec3 vertexPosition;
+
+uniform mat4 MVP;
+uniform vec2 halfSize;
+
+// Position in the shape's own units, 0 at its center
+out vec2 local;
+
+// Room around the shape for the anti-aliased edge
+const float margin = 0.05;
+
+void main ()
+{
+    local = vertexPosition.xy * (halfSize + margin);
+    gl_Position = MVP * vec4(local, 0, 1);
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+in vec4 fragColor;
+in vec2 fragUV;
+
+uniform sampler2D atlas;
+
+out vec4 color;
+
+void main()
+{
+    color = fragColor * texture(atlas, fragUV);
+    // Keep empty atlas texels out of the depth buffer
+    if (color.a < 0.01)
+        discard;
+}
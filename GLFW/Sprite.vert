@@ -0,0 +1,18 @@
+#version 330 core
+
+// input data : one textured, tinted quad corner per vertex
+layout (location = 0) in vec3 vertexPosition;
+layout (location = 1) in vec4 vertexColor;
+layout (location = 2) in vec2 vertexUV;
+
+uniform mat4 MVP;
+
+out vec4 fragColor;
+out vec2 fragUV;
+
+void main ()
+{
+    fragColor = vertexColor;
+    fragUV = vertexUV;
+    gl_Position = MVP * vec4(vertexPosition, 1);
+}
@@ -0,0 +1,214 @@
+/* bench - time the simulation kernels without a window or GL context.
+
+   usage: bench [--bricks=N] [--lasers=N] [--iterations=N] [--repeats=N] [--threads=N]
+
+   Prints one JSON object on stdout, so runs can be diffed between commits.
+   "scaling" times one full tick on the job system with 1..N threads
+   (N defaults to one per hardware thread). */
+
+#include "jobs.h"
+#include "level.h"
+#include "simulate.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+static int bricks = 10000, lasers = 2000, iterations = 200, repeats = 7, threads = 0;
+
+struct World {
+	vector<float> pos, posx;
+	vector<int32_t> color, vis;
+	vector<float> travel, ox, oy, dx, dy, x, y, x1, y1;
+
+	LaserArrays lasers () {
+		LaserArrays l = { &travel[0], &ox[0], &oy[0], &dx[0], &dy[0], &x[0], &y[0], &x1[0], &y1[0] };
+		return l;
+	}
+};
+
+static const LevelData *Level;
+static World W;
+static BrickEvents Events;
+static vector<LaserHit> Hits;
+static double checksum;
+
+/* Bricks spread over the whole field, lasers leaving the cannon in a fan */
+static void reset ()
+{
+	srand(1);
+	W.pos.resize(bricks); W.posx.resize(bricks); W.color.resize(bricks); W.vis.resize(bricks);
+	for (int i=0; i<bricks; i++) {
+		W.pos[i] = -(rand() % 800) / 100.0f;
+		W.posx[i] = Level->spawn.xmin + rand() % Level->spawn.xcount;
+		W.color[i] = rand() % BRICK_COLORS;
+		W.vis[i] = rand() % 4 == 0;
+	}
+	vector<float> *arrays[] = { &W.travel, &W.ox, &W.oy, &W.dx, &W.dy, &W.x, &W.y, &W.x1, &W.y1 };
+	for (int a=0; a<9; a++)
+		arrays[a]->assign(lasers, 0);
+	for (int i=0; i<lasers; i++) {
+		float angle = (rand() % 120 - 60) * M_PI / 180;
+		W.travel[i] = (rand() % 1400) / 100.0f;
+		W.ox[i] = Level->cannon.x;
+		W.oy[i] = Level->cannon.y + (rand() % 600) / 100.0f - 3;
+		W.dx[i] = cos(angle);
+		W.dy[i] = sin(angle);
+		W.x[i] = W.ox[i] + W.travel[i]*W.dx[i];
+		W.y[i] = W.oy[i] + W.travel[i]*W.dy[i];
+	}
+}
+
+static BrickSweep sweep (float fall)
+{
+	BrickSweep s;
+	s.fall = fall;
+	s.red_x = Level->red.x;
+	s.green_x = Level->green.x;
+	s.halfwidth = Level->catchzone.halfwidth;
+	s.top = Level->catchzone.top;
+	s.bottom = Level->catchzone.bottom;
+	s.miss = Level->catchzone.miss;
+	return s;
+}
+
+/* The sweep moves and scores bricks in one pass, so this is both brick
+   integration and basket scoring */
+static void basketScoring ()
+{
+	sweepBricks(&W.pos[0], &W.posx[0], &W.color[0], &W.vis[0], bricks, sweep(0), Events);
+	checksum += 5.0*Events.caught.size() - 3.0*Events.misses.size() + Events.hazards.size();
+	Events.clear();
+}
+
+static void laserAdvance ()
+{
+	advanceLasers(W.lasers(), lasers, 1e-6f, Level->mirrors, 0);
+}
+
+static void mirrorReflection ()
+{
+	advanceLasers(W.lasers(), lasers, 0.2f, Level->mirrors, Level->mirror_count);
+}
+
+/* Laser end points in millionths, so even the slow laser_advance step
+   moves the checksum */
+static double laserPositions ()
+{
+	double sum = 0;
+	for (int i=0; i<lasers; i++)
+		sum += W.x[i] + W.y[i];
+	return floor(sum * 1e6);
+}
+
+static void brickLaserCollision ()
+{
+	collideLasers(&W.pos[0], &W.posx[0], bricks, &W.x[0], &W.y[0], lasers, Hits);
+	checksum += Hits.size();
+}
+
+static JobSystem Jobs;
+
+/* What the game runs per frame: sweep, move lasers, collide */
+static void tick ()
+{
+	sweepBricks(Jobs, &W.pos[0], &W.posx[0], &W.color[0], &W.vis[0], bricks, sweep(1e-6f), Events);
+	checksum += Events.caught.size() + Events.misses.size() + Events.hazards.size();
+	Events.clear();
+	advanceLasers(Jobs, W.lasers(), lasers, 0.2f, Level->mirrors, Level->mirror_count);
+	collideLasers(Jobs, &W.pos[0], &W.posx[0], bricks, &W.x[0], &W.y[0], lasers, Hits);
+	checksum += Hits.size();
+}
+
+/* Median seconds per call of 'run' over 'repeats' runs of 'n' calls, from a
+   fresh world. 'check', when given, adds the world each run leaves behind to
+   the checksum, outside the timing. */
+static double timeKernel (void (*run) (), double (*check) (), int n, double *fastest)
+{
+	vector<double> samples;
+	checksum = 0;
+	for (int r=0; r<repeats; r++) {
+		reset();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (int i=0; i<n; i++)
+			run();
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+		samples.push_back(elapsed.count() / n);
+		if (check)
+			checksum += check();
+	}
+	sort(samples.begin(), samples.end());
+	if (fastest)
+		*fastest = samples[0];
+	return samples[samples.size()/2];
+}
+
+struct Kernel {
+	const char *name;
+	void (*run) ();
+	double (*check) ();
+	double entities;
+};
+
+int main (int argc, char** argv)
+{
+	for (int a=1; a<argc; a++) {
+		if (sscanf(argv[a], "--bricks=%d", &bricks) == 1 || sscanf(argv[a], "--lasers=%d", &lasers) == 1
+				|| sscanf(argv[a], "--iterations=%d", &iterations) == 1 || sscanf(argv[a], "--repeats=%d", &repeats) == 1
+				|| sscanf(argv[a], "--threads=%d", &threads) == 1)
+			continue;
+		fprintf(stderr, "usage: %s [--bricks=N] [--lasers=N] [--iterations=N] [--repeats=N] [--threads=N]\n", argv[0]);
+		return 1;
+	}
+	if (threads == 0)
+		threads = max(1u, thread::hardware_concurrency());
+	if (bricks < 1 || lasers < 1 || iterations < 1 || repeats < 1 || threads < 1) {
+		fprintf(stderr, "%s: counts must be positive\n", argv[0]);
+		return 1;
+	}
+	Level = levelDefault();
+
+	Kernel kernels[] = {
+		{ "basket_scoring", basketScoring, NULL, (double)bricks },
+		{ "laser_advance", laserAdvance, laserPositions, (double)lasers },
+		{ "mirror_reflection", mirrorReflection, laserPositions, (double)lasers * Level->mirror_count },
+		{ "brick_laser_collision", brickLaserCollision, NULL, (double)bricks * lasers },
+	};
+	const int count = sizeof kernels / sizeof kernels[0];
+
+	printf("{\n  \"target\": \"%s\",\n  \"bricks\": %d,\n  \"lasers\": %d,\n  \"mirrors\": %u,\n"
+			"  \"iterations\": %d,\n  \"repeats\": %d,\n  \"kernels\": [\n",
+			simulateTarget(), bricks, lasers, Level->mirror_count, iterations, repeats);
+	for (int k=0; k<count; k++) {
+		// collisions are quadratic: fewer iterations keep the default run short
+		int n = strcmp(kernels[k].name, "brick_laser_collision") ? iterations : max(1, iterations/20);
+		double fastest, median = timeKernel(kernels[k].run, kernels[k].check, n, &fastest);
+		printf("    { \"name\": \"%s\", \"iterations\": %d, \"us_per_call_min\": %.3f, \"us_per_call_median\": %.3f, "
+				"\"ns_per_entity\": %.4f, \"checksum\": %.0f }%s\n",
+				kernels[k].name, n, fastest*1e6, median*1e6, median*1e9/kernels[k].entities,
+				checksum, k+1 < count ? "," : "");
+	}
+	printf("  ],\n  \"scaling\": [\n");
+	// a tick includes the quadratic collision pass, so it gets the collision's iteration count
+	int n = max(1, iterations/20);
+	double serial = 0;
+	for (int t=1; t<=threads; t++) {
+		Jobs.start(t);
+		double median = timeKernel(tick, NULL, n, NULL);
+		if (t == 1)
+			serial = median;
+		printf("    { \"threads\": %d, \"us_per_tick\": %.3f, \"speedup\": %.2f, \"checksum\": %.0f }%s\n",
+				t, median*1e6, serial/median, checksum, t < threads ? "," : "");
+	}
+	Jobs.stop();
+	printf("  ]\n}\n");
+	return 0;
+}
@@ -0,0 +1,145 @@
+/* collector - local stand-in for the telemetry backend. Listens on a UNIX
+   socket (or reads a telemetry file), decodes both protocols and prints
+   every batch as one line on stdout.
+
+   usage: collector --socket=PATH [--batches=N]
+          collector --file=PATH
+
+   With --batches it exits after N batches, so a test can start it, run the
+   game with SAMPLE2D_TELEMETRY=unix:PATH and wait for it. */
+
+#include "telemetry.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+enum StreamState { STREAM_UNKNOWN, STREAM_LINE, STREAM_BINARY, STREAM_BAD };
+
+static long batches = 0, limit = -1;
+
+static void print (const TelemetryBatch &batch)
+{
+	string line;
+	telemetryEncode(batch, TELEMETRY_LINE, line);
+	fputs(line.c_str(), stdout);
+	fflush(stdout);
+	batches++;
+}
+
+/* Decode every complete batch at the front of 'pending' and drop it */
+static void consume (string &pending, StreamState &state)
+{
+	if (state == STREAM_UNKNOWN && pending.size() >= 4) {
+		// The binary protocol starts with its magic, lines with "t="
+		if (pending.compare(0, 4, "S2DT") != 0)
+			state = STREAM_LINE;
+		else if (pending.size() >= TELEMETRY_HEADER_SIZE) {
+			state = telemetryCheckHeader((const uint8_t*)pending.data()) ? STREAM_BINARY : STREAM_BAD;
+			pending.erase(0, TELEMETRY_HEADER_SIZE);
+		}
+	}
+	TelemetryBatch batch;
+	size_t used = 0;
+	if (state == STREAM_BINARY)
+		for (; pending.size() - used >= TELEMETRY_RECORD_SIZE; used += TELEMETRY_RECORD_SIZE) {
+			if (!telemetryDecodeRecord((const uint8_t*)pending.data() + used, batch)) {
+				state = STREAM_BAD;
+				break;
+			}
+			print(batch);
+		}
+	else if (state == STREAM_LINE)
+		for (size_t end; (end = pending.find('\n', used)) != string::npos; used = end + 1) {
+			string line = pending.substr(used, end - used);
+			if (telemetryDecodeLine(line.c_str(), batch))
+				print(batch);
+			else
+				fprintf(stderr, "collector: skipping malformed line '%s'\n", line.c_str());
+		}
+	pending.erase(0, used);
+	if (state == STREAM_BAD)
+		fprintf(stderr, "collector: not a telemetry stream\n");
+}
+
+static int readFile (const char *path)
+{
+	FILE *in = fopen(path, "rb");
+	if (!in) {
+		perror(path);
+		return 1;
+	}
+	string pending;
+	StreamState state = STREAM_UNKNOWN;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof buffer, in)) > 0 && state != STREAM_BAD) {
+		pending.append(buffer, n);
+		consume(pending, state);
+	}
+	fclose(in);
+	return state == STREAM_BAD;
+}
+
+static int listenSocket (const char *path)
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof address.sun_path) {
+		fprintf(stderr, "%s: socket path too long\n", path);
+		return 1;
+	}
+	strcpy(address.sun_path, path);
+	unlink(path);
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || bind(server, (struct sockaddr*)&address, sizeof address) != 0 || listen(server, 4) != 0) {
+		perror(path);
+		return 1;
+	}
+	// One game at a time; a new connection starts a new stream
+	while (limit < 0 || batches < limit) {
+		int client = accept(server, NULL, NULL);
+		if (client < 0) {
+			perror("accept");
+			break;
+		}
+		string pending;
+		StreamState state = STREAM_UNKNOWN;
+		char buffer[4096];
+		ssize_t n;
+		while ((limit < 0 || batches < limit) && state != STREAM_BAD
+				&& (n = read(client, buffer, sizeof buffer)) > 0) {
+			pending.append(buffer, n);
+			consume(pending, state);
+		}
+		close(client);
+	}
+	close(server);
+	unlink(path);
+	return 0;
+}
+
+int main (int argc, char** argv)
+{
+	const char *socket_path = NULL, *file_path = NULL;
+	bool usage = false;
+	for (int a=1; a<argc; a++) {
+		if (strncmp(argv[a], "--socket=", 9) == 0)
+			socket_path = argv[a] + 9;
+		else if (strncmp(argv[a], "--file=", 7) == 0)
+			file_path = argv[a] + 7;
+		else if (sscanf(argv[a], "--batches=%ld", &limit) != 1 || limit < 1)
+			usage = true;
+	}
+	if (usage || !socket_path == !file_path) {
+		fprintf(stderr, "usage: %s --socket=PATH [--batches=N]\n       %s --file=PATH\n", argv[0], argv[0]);
+		return 1;
+	}
+	return file_path ? readFile(file_path) : listenSocket(socket_path);
+}
@@ -0,0 +1,387 @@
+#include "commands.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <string.h>
+
+using namespace std;
+
+enum Opcode {
+	CMD_CLEAR, CMD_CLEAR_COLOR, CMD_VIEWPORT, CMD_USE_PROGRAM,
+	CMD_UNIFORM_MATRIX4, CMD_UNIFORM1I, CMD_UNIFORM1F, CMD_UNIFORM2F, CMD_UNIFORM3F,
+	CMD_ENABLE, CMD_DISABLE, CMD_BLEND_FUNC, CMD_POLYGON_MODE,
+	CMD_BIND_TEXTURE, CMD_BIND_FRAMEBUFFER, CMD_BIND_VERTEX_ARRAY, CMD_DRAW_ARRAYS,
+	CMD_DRAW_OBJECT, CMD_STREAM_VERTICES, CMD_TEXTURE_STORAGE, CMD_ATTACH_TEXTURE
+};
+
+uint8_t* CommandBuffer::reserve (size_t size)
+{
+	if (used + size > bytes.size())
+		bytes.resize(max(2*bytes.size(), used + size));
+	uint8_t *p = &bytes[used];
+	used += size;
+	return p;
+}
+
+/* Records are packed with no padding, so values are copied in and out */
+template <typename T>
+static inline void put (CommandBuffer *commands, T value)
+{
+	memcpy(commands->reserve(sizeof(T)), &value, sizeof(T));
+}
+
+template <typename T>
+static inline T get (const uint8_t *&p)
+{
+	T value;
+	memcpy(&value, p, sizeof(T));
+	p += sizeof(T);
+	return value;
+}
+
+static inline void op (CommandBuffer *commands, Opcode code)
+{
+	put<uint8_t>(commands, code);
+}
+
+void CommandBuffer::clear (uint32_t mask)
+{
+	op(this, CMD_CLEAR);
+	put(this, mask);
+}
+
+void CommandBuffer::clearColor (float r, float g, float b, float a)
+{
+	op(this, CMD_CLEAR_COLOR);
+	put(this, r); put(this, g); put(this, b); put(this, a);
+}
+
+void CommandBuffer::viewport (int32_t x, int32_t y, int32_t width, int32_t height)
+{
+	op(this, CMD_VIEWPORT);
+	put(this, x); put(this, y); put(this, width); put(this, height);
+}
+
+void CommandBuffer::useProgram (uint32_t program)
+{
+	op(this, CMD_USE_PROGRAM);
+	put(this, program);
+}
+
+void CommandBuffer::uniformMatrix4 (int32_t location, const float *matrix)
+{
+	op(this, CMD_UNIFORM_MATRIX4);
+	put(this, location);
+	memcpy(reserve(16*sizeof(float)), matrix, 16*sizeof(float));
+}
+
+void CommandBuffer::uniform1i (int32_t location, int32_t v)
+{
+	op(this, CMD_UNIFORM1I);
+	put(this, location); put(this, v);
+}
+
+void CommandBuffer::uniform1f (int32_t location, float v)
+{
+	op(this, CMD_UNIFORM1F);
+	put(this, location); put(this, v);
+}
+
+void CommandBuffer::uniform2f (int32_t location, float v0, float v1)
+{
+	op(this, CMD_UNIFORM2F);
+	put(this, location); put(this, v0); put(this, v1);
+}
+
+void CommandBuffer::uniform3f (int32_t location, float v0, float v1, float v2)
+{
+	op(this, CMD_UNIFORM3F);
+	put(this, location); put(this, v0); put(this, v1); put(this, v2);
+}
+
+void CommandBuffer::enable (uint32_t capability)
+{
+	op(this, CMD_ENABLE);
+	put(this, capability);
+}
+
+void CommandBuffer::disable (uint32_t capability)
+{
+	op(this, CMD_DISABLE);
+	put(this, capability);
+}
+
+void CommandBuffer::blendFunc (uint32_t source, uint32_t destination)
+{
+	op(this, CMD_BLEND_FUNC);
+	put(this, source); put(this, destination);
+}
+
+void CommandBuffer::polygonMode (uint32_t mode)
+{
+	op(this, CMD_POLYGON_MODE);
+	put(this, mode);
+}
+
+void CommandBuffer::bindTexture (uint32_t texture)
+{
+	op(this, CMD_BIND_TEXTURE);
+	put(this, texture);
+}
+
+void CommandBuffer::bindFramebuffer (uint32_t framebuffer)
+{
+	op(this, CMD_BIND_FRAMEBUFFER);
+	put(this, framebuffer);
+}
+
+void CommandBuffer::bindVertexArray (uint32_t array)
+{
+	op(this, CMD_BIND_VERTEX_ARRAY);
+	put(this, array);
+}
+
+void CommandBuffer::drawArrays (uint32_t mode, int32_t first, int32_t count)
+{
+	op(this, CMD_DRAW_ARRAYS);
+	put(this, mode); put(this, first); put(this, count);
+}
+
+void CommandBuffer::drawObject (uint32_t array, uint32_t vertices, uint32_t colors,
+		uint32_t fill_mode, uint32_t primitive, int32_t count)
+{
+	op(this, CMD_DRAW_OBJECT);
+	put(this, array); put(this, vertices); put(this, colors);
+	put(this, fill_mode); put(this, primitive); put(this, count);
+}
+
+void CommandBuffer::streamVertices (uint32_t buffer, uint32_t capacity, const void *data, uint32_t size)
+{
+	op(this, CMD_STREAM_VERTICES);
+	put(this, buffer); put(this, capacity); put(this, size);
+	memcpy(reserve(size), data, size);
+}
+
+void CommandBuffer::textureStorage (uint32_t texture, int32_t width, int32_t height)
+{
+	op(this, CMD_TEXTURE_STORAGE);
+	put(this, texture); put(this, width); put(this, height);
+}
+
+void CommandBuffer::attachTexture (uint32_t framebuffer, uint32_t texture)
+{
+	op(this, CMD_ATTACH_TEXTURE);
+	put(this, framebuffer); put(this, texture);
+}
+
+/* Operand bytes after each opcode, in Opcode order; CMD_STREAM_VERTICES is
+   followed by 'size' more bytes of vertex data */
+static const uint32_t OPERAND_BYTES[] = {
+	4, 16, 16, 4,
+	4 + 64, 8, 8, 12, 16,
+	4, 4, 8, 4,
+	4, 4, 4, 12,
+	24, 12, 12, 8
+};
+static const int OPCODES = sizeof OPERAND_BYTES / sizeof OPERAND_BYTES[0];
+
+/* Walk the frame without issuing anything: every opcode known and every
+   operand and payload inside 'used'. Returns the offset of the first bad
+   command, or -1 when the whole frame is sound. */
+static long checkFrame (const CommandBuffer &commands)
+{
+	const uint8_t *start = commands.bytes.data(), *p = start, *end = start + commands.used;
+	while (p < end) {
+		const uint8_t *command = p;
+		uint8_t code = get<uint8_t>(p);
+		if (code >= OPCODES || OPERAND_BYTES[code] > (size_t)(end - p))
+			return command - start;
+		if (code == CMD_STREAM_VERTICES) {
+			uint32_t capacity, size;
+			memcpy(&capacity, p + 4, 4);
+			memcpy(&size, p + 8, 4);
+			p += OPERAND_BYTES[code];
+			if (size > capacity || size > (size_t)(end - p))
+				return command - start;
+			p += size;
+		}
+		else
+			p += OPERAND_BYTES[code];
+	}
+	return -1;
+}
+
+void replay (const CommandBuffer &commands)
+{
+	// A frame that fails the check is dropped whole, before any GL call
+	long bad = checkFrame(commands);
+	if (bad >= 0) {
+		fprintf(stderr, "replay: bad or truncated command at byte %ld, frame dropped\n", bad);
+		return;
+	}
+	const uint8_t *p = commands.bytes.data(), *end = p + commands.used;
+	// Operands are read into locals first: argument evaluation order is unspecified
+	while (p < end)
+		switch (get<uint8_t>(p)) {
+		case CMD_CLEAR:
+			glClear(get<uint32_t>(p));
+			break;
+		case CMD_CLEAR_COLOR: {
+			float r = get<float>(p), g = get<float>(p), b = get<float>(p), a = get<float>(p);
+			glClearColor(r, g, b, a);
+			break;
+		}
+		case CMD_VIEWPORT: {
+			int32_t x = get<int32_t>(p), y = get<int32_t>(p);
+			int32_t width = get<int32_t>(p), height = get<int32_t>(p);
+			glViewport(x, y, width, height);
+			break;
+		}
+		case CMD_USE_PROGRAM:
+			glUseProgram(get<uint32_t>(p));
+			break;
+		case CMD_UNIFORM_MATRIX4: {
+			int32_t location = get<int32_t>(p);
+			float matrix[16];
+			memcpy(matrix, p, sizeof(matrix));
+			p += sizeof(matrix);
+			glUniformMatrix4fv(location, 1, GL_FALSE, matrix);
+			break;
+		}
+		case CMD_UNIFORM1I: {
+			int32_t location = get<int32_t>(p), v = get<int32_t>(p);
+			glUniform1i(location, v);
+			break;
+		}
+		case CMD_UNIFORM1F: {
+			int32_t location = get<int32_t>(p);
+			float v = get<float>(p);
+			glUniform1f(location, v);
+			break;
+		}
+		case CMD_UNIFORM2F: {
+			int32_t location = get<int32_t>(p);
+			float v0 = get<float>(p), v1 = get<float>(p);
+			glUniform2f(location, v0, v1);
+			break;
+		}
+		case CMD_UNIFORM3F: {
+			int32_t location = get<int32_t>(p);
+			float v0 = get<float>(p), v1 = get<float>(p), v2 = get<float>(p);
+			glUniform3f(location, v0, v1, v2);
+			break;
+		}
+		case CMD_ENABLE:
+			glEnable(get<uint32_t>(p));
+			break;
+		case CMD_DISABLE:
+			glDisable(get<uint32_t>(p));
+			break;
+		case CMD_BLEND_FUNC: {
+			uint32_t source = get<uint32_t>(p), destination = get<uint32_t>(p);
+			glBlendFunc(source, destination);
+			break;
+		}
+		case CMD_POLYGON_MODE:
+			glPolygonMode(GL_FRONT_AND_BACK, get<uint32_t>(p));
+			break;
+		case CMD_BIND_TEXTURE:
+			glBindTexture(GL_TEXTURE_2D, get<uint32_t>(p));
+			break;
+		case CMD_BIND_FRAMEBUFFER:
+			glBindFramebuffer(GL_FRAMEBUFFER, get<uint32_t>(p));
+			break;
+		case CMD_BIND_VERTEX_ARRAY:
+			glBindVertexArray(get<uint32_t>(p));
+			break;
+		case CMD_DRAW_ARRAYS: {
+			uint32_t mode = get<uint32_t>(p);
+			int32_t first = get<int32_t>(p), count = get<int32_t>(p);
+			glDrawArrays(mode, first, count);
+			break;
+		}
+		case CMD_DRAW_OBJECT: {
+			uint32_t array = get<uint32_t>(p), vertices = get<uint32_t>(p), colors = get<uint32_t>(p);
+			uint32_t fill_mode = get<uint32_t>(p), primitive = get<uint32_t>(p);
+			int32_t count = get<int32_t>(p);
+			glPolygonMode(GL_FRONT_AND_BACK, fill_mode);
+			glBindVertexArray(array);
+			glEnableVertexAttribArray(0);
+			glBindBuffer(GL_ARRAY_BUFFER, vertices);
+			glEnableVertexAttribArray(1);
+			glBindBuffer(GL_ARRAY_BUFFER, colors);
+			glDrawArrays(primitive, 0, count);
+			break;
+		}
+		case CMD_STREAM_VERTICES: {
+			uint32_t buffer = get<uint32_t>(p), capacity = get<uint32_t>(p), size = get<uint32_t>(p);
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+			glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, size, p);
+			p += size;
+			break;
+		}
+		case CMD_TEXTURE_STORAGE: {
+			uint32_t texture = get<uint32_t>(p);
+			int32_t width = get<int32_t>(p), height = get<int32_t>(p);
+			glBindTexture(GL_TEXTURE_2D, texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			break;
+		}
+		case CMD_ATTACH_TEXTURE: {
+			uint32_t framebuffer = get<uint32_t>(p), texture = get<uint32_t>(p);
+			glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+			break;
+		}
+		default:	// unreachable after checkFrame()
+			return;
+		}
+}
+
+static const char CAPTURE_MAGIC[4] = { 'S', '2', 'D', 'C' };
+static const uint32_t CAPTURE_VERSION = 1;
+
+bool captureBegin (FILE *out)
+{
+	return fwrite(CAPTURE_MAGIC, 4, 1, out) == 1 && fwrite(&CAPTURE_VERSION, 4, 1, out) == 1;
+}
+
+bool captureFrame (FILE *out, const CommandBuffer &commands)
+{
+	uint32_t size = commands.used;
+	return fwrite(&size, 4, 1, out) == 1 && (size == 0 || fwrite(commands.bytes.data(), size, 1, out) == 1);
+}
+
+bool captureCheck (FILE *in)
+{
+	char magic[4];
+	uint32_t version;
+	return fread(magic, 4, 1, in) == 1 && memcmp(magic, CAPTURE_MAGIC, 4) == 0
+		&& fread(&version, 4, 1, in) == 1 && version == CAPTURE_VERSION;
+}
+
+/* No frame the game records comes near this; a larger size is corruption */
+static const uint32_t CAPTURE_FRAME_MAX = 64 << 20;
+
+bool captureRead (FILE *in, CommandBuffer &commands)
+{
+	uint32_t size;
+	if (fread(&size, 4, 1, in) != 1)
+		return false;
+	// Check the size before reserving for it, against what is left when the file can seek
+	long at = ftell(in), left = -1;
+	if (at >= 0 && fseek(in, 0, SEEK_END) == 0) {
+		left = ftell(in) - at;
+		fseek(in, at, SEEK_SET);
+	}
+	if (size > CAPTURE_FRAME_MAX || (left >= 0 && size > left)) {
+		fprintf(stderr, "replay: frame of %u bytes at byte %ld is %s\n", size, at - 4,
+				size > CAPTURE_FRAME_MAX ? "too large" : "truncated");
+		return false;
+	}
+	commands.reset();
+	return size == 0 || fread(commands.reserve(size), size, 1, in) == 1;
+}
@@ -0,0 +1,66 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+/* One frame of GL work, recorded as compact opcode + payload records by the
+   game thread and replayed later, usually by the render thread (see
+   renderer.h). Methods mirror the GL calls they stand for. The byte store
+   only ever grows, so once it has reached a frame's size recording does not
+   allocate.
+
+   A buffer can also be written to a capture file and replayed without the
+   game. It refers to GL objects by name, so a capture replays only in a
+   process that created its objects in the same order, i.e. sample2D itself
+   after initGL(). */
+struct CommandBuffer {
+	std::vector<uint8_t> bytes;
+	size_t used;
+	double input_time;	// when this frame's input was sampled, for the frame pacer
+
+	CommandBuffer () : used(0), input_time(0) {}
+	void reset () { used = 0; }
+
+	void clear (uint32_t mask);
+	void clearColor (float r, float g, float b, float a);
+	void viewport (int32_t x, int32_t y, int32_t width, int32_t height);
+	void useProgram (uint32_t program);
+	void uniformMatrix4 (int32_t location, const float *matrix);
+	void uniform1i (int32_t location, int32_t v);
+	void uniform1f (int32_t location, float v);
+	void uniform2f (int32_t location, float v0, float v1);
+	void uniform3f (int32_t location, float v0, float v1, float v2);
+	void enable (uint32_t capability);
+	void disable (uint32_t capability);
+	void blendFunc (uint32_t source, uint32_t destination);
+	void polygonMode (uint32_t mode);
+	void bindTexture (uint32_t texture);
+	void bindFramebuffer (uint32_t framebuffer);
+	void bindVertexArray (uint32_t array);
+	void drawArrays (uint32_t mode, int32_t first, int32_t count);
+
+	/* Everything draw3DObject() does for one VAO with a vertex and a color buffer */
+	void drawObject (uint32_t array, uint32_t vertices, uint32_t colors,
+			uint32_t fill_mode, uint32_t primitive, int32_t count);
+	/* Orphan 'buffer' at 'capacity' bytes, then upload 'size' bytes copied from 'data' */
+	void streamVertices (uint32_t buffer, uint32_t capacity, const void *data, uint32_t size);
+	/* (Re)allocate an RGBA8 2D texture, contents undefined */
+	void textureStorage (uint32_t texture, int32_t width, int32_t height);
+	/* Make 'texture' the color attachment of 'framebuffer' */
+	void attachTexture (uint32_t framebuffer, uint32_t texture);
+
+	uint8_t* reserve (size_t size);
+};
+
+/* Issue the recorded calls; needs a current GL context */
+void replay (const CommandBuffer &commands);
+
+/* Capture files: a header, then one length-prefixed frame after another */
+bool captureBegin (FILE *out);
+bool captureFrame (FILE *out, const CommandBuffer &commands);
+bool captureCheck (FILE *in);
+bool captureRead (FILE *in, CommandBuffer &commands);
+
+#endif
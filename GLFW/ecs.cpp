@@ -0,0 +1,155 @@
+#include "ecs.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+/* Fields of each component, in Component bit order */
+static const Field COMPONENT_FIELDS[][5] = {
+	{ FIELD_X, FIELD_Y, FIELD_ANGLE, FIELD_COUNT },
+	{ FIELD_DX, FIELD_DY, FIELD_COUNT },
+	{ FIELD_COLOR, FIELD_COUNT },
+	{ FIELD_X0, FIELD_Y0, FIELD_X1, FIELD_Y1, FIELD_COUNT },
+	{ FIELD_AGE, FIELD_GONE, FIELD_COUNT },
+};
+static const int COMPONENTS = sizeof COMPONENT_FIELDS / sizeof COMPONENT_FIELDS[0];
+
+Archetype::Archetype (uint32_t m)
+{
+	mask = m;
+	fields = 0;
+	for (int f=0; f<FIELD_COUNT; f++)
+		offset[f] = -1;
+	for (int c=0; c<COMPONENTS; c++)
+		if (mask & (1u << c))
+			for (const Field *f=COMPONENT_FIELDS[c]; *f != FIELD_COUNT; f++)
+				offset[*f] = fields++;
+	// Multiples of 8 rows keep every column 32-byte aligned for the kernels
+	capacity = fields ? CHUNK_BYTES / (fields * 4) / 8 * 8 : CHUNK_BYTES / 8;
+	for (int f=0; f<FIELD_COUNT; f++)
+		if (offset[f] >= 0)
+			offset[f] *= capacity * 4;
+	count = 0;
+}
+
+Archetype::~Archetype ()
+{
+	for (size_t c=0; c<chunks.size(); c++)
+		free(chunks[c].data);
+}
+
+/* Set the row counts for 'n' entities, allocating chunks as needed */
+static void setCount (Archetype &a, int n)
+{
+	int used = (n + a.capacity - 1) / a.capacity;
+	while ((int)a.chunks.size() < used) {
+		Archetype::Chunk chunk = { 0, NULL };
+		if (posix_memalign((void**)&chunk.data, 64, CHUNK_BYTES) != 0)
+			abort();
+		a.chunks.push_back(chunk);
+	}
+	for (size_t c=0; c<a.chunks.size(); c++) {
+		int rows = n - (int)c * a.capacity;
+		a.chunks[c].count = rows < 0 ? 0 : rows > a.capacity ? a.capacity : rows;
+	}
+	a.count = n;
+}
+
+int Archetype::add ()
+{
+	int index = count;
+	resize(count + 1);
+	return index;
+}
+
+void Archetype::remove (int index)
+{
+	int last = count - 1;
+	if (index != last)
+		for (int f=0; f<FIELD_COUNT; f++)
+			if (has(Field(f)))
+				i(Field(f), index) = i(Field(f), last);
+	resize(last);
+}
+
+/* Zero rows [from, to) column by column within each chunk; the chunks must
+   already be allocated */
+static void zeroRows (Archetype &a, int from, int to)
+{
+	for (int c = from / a.capacity; c * a.capacity < to; c++) {
+		int first = c == from / a.capacity ? from % a.capacity : 0;
+		int last = to - c * a.capacity < a.capacity ? to - c * a.capacity : a.capacity;
+		for (int f=0; f<FIELD_COUNT; f++)
+			if (a.has(Field(f)))
+				memset(a.ints(c, Field(f)) + first, 0, (last - first) * 4);
+	}
+}
+
+void Archetype::resize (int n)
+{
+	int old = count;
+	setCount(*this, n);
+	if (n > old)
+		zeroRows(*this, old, n);
+}
+
+void Archetype::save (vector<uint8_t> &out) const
+{
+	size_t at = out.size();
+	out.resize(at + 4 + (size_t)count * fields * 4);
+	uint8_t *p = &out[at];
+	int32_t n = count;
+	memcpy(p, &n, 4);
+	p += 4;
+	for (int c=0; c<chunkCount(); c++)
+		for (int f=0; f<FIELD_COUNT; f++)
+			if (offset[f] >= 0) {
+				memcpy(p, chunks[c].data + offset[f], chunks[c].count * 4);
+				p += chunks[c].count * 4;
+			}
+}
+
+size_t Archetype::load (const uint8_t *in)
+{
+	const uint8_t *p = in;
+	int32_t n;
+	memcpy(&n, p, 4);
+	p += 4;
+	// Every live row is overwritten; rows the restored state no longer has
+	// are zeroed so nothing of the abandoned timeline stays in the chunks
+	int old = count;
+	setCount(*this, n);
+	if (old > n)
+		zeroRows(*this, n, old);
+	for (int c=0; c<chunkCount(); c++)
+		for (int f=0; f<FIELD_COUNT; f++)
+			if (offset[f] >= 0) {
+				memcpy(chunks[c].data + offset[f], p, chunks[c].count * 4);
+				p += chunks[c].count * 4;
+			}
+	return p - in;
+}
+
+Archetype &World::archetype (uint32_t mask)
+{
+	for (size_t a=0; a<archetypes.size(); a++)
+		if (archetypes[a]->mask == mask)
+			return *archetypes[a];
+	archetypes.push_back(unique_ptr<Archetype>(new Archetype(mask)));
+	return *archetypes.back();
+}
+
+void World::save (vector<uint8_t> &out) const
+{
+	for (size_t a=0; a<archetypes.size(); a++)
+		archetypes[a]->save(out);
+}
+
+size_t World::load (const uint8_t *in)
+{
+	size_t read = 0;
+	for (size_t a=0; a<archetypes.size(); a++)
+		read += archetypes[a]->load(in + read);
+	return read;
+}
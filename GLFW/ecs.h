@@ -0,0 +1,98 @@
+#ifndef ECS_H
+#define ECS_H
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+/* Entity storage by archetype. An archetype is a set of components; all
+   entities with exactly that set live together in fixed-size chunks, and
+   every field of every component is its own column inside a chunk, so a
+   system walks chunk by chunk over tightly packed floats. A new kind of
+   object is a new archetype, not a new set of global arrays.
+
+   Entities are addressed by their index in the archetype. Indices are
+   dense: add() appends, remove() moves the last entity into the hole. */
+
+enum Component {
+	TRANSFORM	= 1 << 0,	// x, y, angle
+	VELOCITY	= 1 << 1,	// dx, dy: unit direction
+	COLOR		= 1 << 2,	// color: BrickColor
+	COLLIDER	= 1 << 3,	// x0, y0, x1, y1: segment tested against others
+	LIFETIME	= 1 << 4,	// age: distance travelled, gone: nonzero once out of play
+};
+
+/* Columns; every field is 4 bytes, float or int32_t */
+enum Field {
+	FIELD_X, FIELD_Y, FIELD_ANGLE,
+	FIELD_DX, FIELD_DY,
+	FIELD_COLOR,
+	FIELD_X0, FIELD_Y0, FIELD_X1, FIELD_Y1,
+	FIELD_AGE, FIELD_GONE,
+	FIELD_COUNT
+};
+
+/* Bytes per chunk; the entities per chunk follow from the archetype's width */
+const int CHUNK_BYTES = 16384;
+
+struct Archetype {
+	struct Chunk {
+		int count;
+		uint8_t *data;
+	};
+
+	uint32_t mask;					// Component bits
+	int capacity;					// entities per chunk, a multiple of 8
+	int offset[FIELD_COUNT];		// byte offset of each column in a chunk, -1 when absent
+	int fields;						// columns present
+	std::vector<Chunk> chunks;		// full chunks first; emptied chunks are kept for reuse
+	int count;						// live entities
+
+	Archetype (uint32_t mask);
+	~Archetype ();
+
+	/* Append one zeroed entity and return its index */
+	int add ();
+	/* Drop entity 'index'; the last entity takes its index */
+	void remove (int index);
+	/* Grow with zeroed entities or drop from the end */
+	void resize (int count);
+	void clear () { resize(0); }
+
+	bool has (Field f) const { return offset[f] >= 0; }
+
+	/* Chunks in use and the columns of one of them. Entity 'row' of chunk
+	   'c' has index c*capacity+row. */
+	int chunkCount () const { return (count + capacity - 1) / capacity; }
+	int rows (int c) const { return chunks[c].count; }
+	float *floats (int c, Field f) { return (float*)(chunks[c].data + offset[f]); }
+	int32_t *ints (int c, Field f) { return (int32_t*)(chunks[c].data + offset[f]); }
+
+	/* One field of one entity, for code outside the systems */
+	float &f (Field field, int index) { return floats(index / capacity, field)[index % capacity]; }
+	int32_t &i (Field field, int index) { return ints(index / capacity, field)[index % capacity]; }
+
+	/* Serialize the live entities column by column, chunk by chunk, so an
+	   entity added at the end only moves bytes of the last chunk */
+	void save (std::vector<uint8_t> &out) const;
+	/* Restore what save() wrote; returns the bytes read */
+	size_t load (const uint8_t *in);
+
+private:
+	Archetype (const Archetype&);
+	void operator= (const Archetype&);
+};
+
+struct World {
+	std::vector< std::unique_ptr<Archetype> > archetypes;
+
+	/* The archetype for exactly 'mask', created on first use. The reference
+	   stays valid for the life of the world. */
+	Archetype &archetype (uint32_t mask);
+
+	/* Every archetype in creation order */
+	void save (std::vector<uint8_t> &out) const;
+	size_t load (const uint8_t *in);
+};
+
+#endif
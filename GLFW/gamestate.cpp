@@ -0,0 +1,59 @@
+#include "gamestate.h"
+#include "instrument.h"
+
+static const char *NAMES[STATE_COUNT] = { "menu", "playing", "paused", "game over" };
+
+static const unsigned SYSTEMS[STATE_COUNT] = {
+	0,
+	SYSTEM_CONTROL | SYSTEM_SPAWN | SYSTEM_BRICKS | SYSTEM_LASERS | SYSTEM_COLLIDE | SYSTEM_FIELD | SYSTEM_REWIND,
+	SYSTEM_FIELD,
+	0,
+};
+
+const char *gameStateName (GameState state)
+{
+	return NAMES[state];
+}
+
+GameStates::GameStates (GameState initial)
+{
+	state = frame_state = initial;
+	frame_start = -1;
+	for (int s=0; s<STATE_COUNT; s++) {
+		frame_count[s] = 0;
+		cpu_seconds[s] = 0;
+	}
+}
+
+unsigned GameStates::systems (GameState state)
+{
+	return SYSTEMS[state];
+}
+
+void GameStates::set (GameState next)
+{
+	state = next;
+}
+
+void GameStates::beginFrame ()
+{
+	frame_state = state;
+	frame_start = instrumentThreadCPU();
+}
+
+void GameStates::endFrame ()
+{
+	if (frame_start < 0)
+		return;
+	frame_count[frame_state]++;
+	cpu_seconds[frame_state] += instrumentThreadCPU() - frame_start;
+	frame_start = -1;
+}
+
+void GameStates::report () const
+{
+	for (int s=0; s<STATE_COUNT; s++)
+		if (frame_count[s])
+			instrumentNote("state %-9s %6ld frames, %7.3f ms CPU per frame, %8.1f ms in all",
+					NAMES[s], frame_count[s], cpu_seconds[s]*1e3/frame_count[s], cpu_seconds[s]*1e3);
+}
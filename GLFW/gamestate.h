@@ -0,0 +1,58 @@
+#ifndef GAMESTATE_H
+#define GAMESTATE_H
+
+/* The game's top-level states and the per-frame systems each one runs.
+   Whatever a state does not list is not run at all, so a paused or
+   finished game costs only its drawing. Frame CPU time is charged to the
+   state the frame ran in and reported through instrumentNote(). */
+
+enum GameState {
+	STATE_MENU,			// level preview; 1-9 picks the level, Enter or the play button starts
+	STATE_PLAYING,
+	STATE_PAUSED,		// the field is frozen but still drawn
+	STATE_GAMEOVER,		// final score; Enter or the restart button plays again
+	STATE_COUNT
+};
+
+enum GameSystem {
+	SYSTEM_CONTROL	= 1 << 0,	// keys, drags and clicks that move the baskets and cannon or fire
+	SYSTEM_SPAWN	= 1 << 1,	// a new brick every spawn interval
+	SYSTEM_BRICKS	= 1 << 2,	// fall, catch and miss
+	SYSTEM_LASERS	= 1 << 3,	// flight and mirror bounces
+	SYSTEM_COLLIDE	= 1 << 4,	// lasers against bricks
+	SYSTEM_FIELD	= 1 << 5,	// draw the baskets, cannon, bricks and lasers
+	SYSTEM_REWIND	= 1 << 6,	// snapshot every frame for rewinding
+};
+
+const char *gameStateName (GameState state);
+
+struct GameStates {
+	GameState state;
+
+	GameStates (GameState initial);
+
+	/* Systems 'state' runs each frame */
+	static unsigned systems (GameState state);
+	bool runs (GameSystem system) const { return (systems(state) & system) != 0; }
+
+	void set (GameState next);
+
+	/* Bracket one frame's work; the time goes to the state it started in */
+	void beginFrame ();
+	void endFrame ();
+
+	/* Frames and CPU seconds spent in 'state' */
+	long frames (GameState s) const { return frame_count[s]; }
+	double cpu (GameState s) const { return cpu_seconds[s]; }
+
+	/* One instrumentation note per state that ran any frames */
+	void report () const;
+
+private:
+	GameState frame_state;
+	double frame_start;
+	long frame_count[STATE_COUNT];
+	double cpu_seconds[STATE_COUNT];
+};
+
+#endif
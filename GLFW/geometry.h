@@ -0,0 +1,46 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include <cmath>
+
+/* Compile-time vertex tables. Bind each table to a 'static constexpr'
+   variable so the compiler evaluates it and it lands in read-only data
+   rather than being computed (on the stack) at every launch. */
+
+template <int N>
+struct GeometryTable {
+	float data[N];
+
+	constexpr const float* values () const { return data; }
+	static constexpr int size () { return N; }
+};
+
+/* Axis-aligned rectangle as two GL_TRIANGLES, wound like the hand-written ones */
+constexpr GeometryTable<18> rectTable (double x0, double y0, double x1, double y1)
+{
+	GeometryTable<18> t = {{
+		(float)x0,(float)y0,0, // vertex 1
+		(float)x1,(float)y0,0, // vertex 2
+		(float)x1,(float)y1,0, // vertex 3
+
+		(float)x1,(float)y1,0, // vertex 3
+		(float)x0,(float)y1,0, // vertex 4
+		(float)x0,(float)y0,0  // vertex 1
+	}};
+	return t;
+}
+
+/* The same rgb for every vertex */
+template <int Vertices>
+constexpr GeometryTable<Vertices*3> colorTable (double r, double g, double b)
+{
+	GeometryTable<Vertices*3> t = {};
+	for (int i=0; i<Vertices; i++) {
+		t.data[3*i] = r;
+		t.data[3*i+1] = g;
+		t.data[3*i+2] = b;
+	}
+	return t;
+}
+
+#endif
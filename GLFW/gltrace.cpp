@@ -0,0 +1,184 @@
+#include "gltrace.h"
+#include "instrument.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+/* Binary trace: a header, the entry point names, then fixed-size records.
+   A record with entry FRAME_MARK ends a frame. Times are nanoseconds since
+   installation. */
+static const char TRACE_MAGIC[4] = { 'S', 'G', 'L', 'T' };
+static const uint32_t TRACE_VERSION = 1;
+static const uint16_t FRAME_MARK = 0xffff;
+
+#pragma pack(push, 1)
+struct TraceRecord {
+	uint16_t entry;
+	uint64_t start;
+	uint32_t duration;
+};
+#pragma pack(pop)
+
+struct Entry {
+	const char *name;
+	long calls;
+	double seconds;
+};
+
+/* Wrappers run on whichever thread holds the context, the render thread
+   once it is started. 'frames' and 'total' are read from the game thread
+   while it runs, so they are atomic; everything else is only read by
+   glTraceReport(), after the render thread has stopped. */
+static vector<Entry> entries;
+static bool active, timing;
+static FILE *trace;
+static vector<TraceRecord> pending;
+static double origin;
+static atomic<long> frames, total;
+
+static void flush ()
+{
+	if (trace && !pending.empty())
+		fwrite(&pending[0], sizeof(TraceRecord), pending.size(), trace);
+	pending.clear();
+}
+
+static void record (int id, double start, double end)
+{
+	TraceRecord r;
+	r.entry = id;
+	r.start = (uint64_t)((start - origin) * 1e9);
+	r.duration = (uint32_t)((end - start) * 1e9);
+	pending.push_back(r);
+	if (pending.size() >= 4096)
+		flush();
+}
+
+/* One wrapper per glad pointer: the pointer's own type gives the signature */
+template <typename P, P *slot> struct Hook;
+
+template <typename R, typename... A, R (**slot)(A...)>
+struct Hook<R (*)(A...), slot> {
+	static R (*real)(A...);
+	static int id;
+
+	struct Scope {
+		double start;
+		Scope () : start(timing || trace ? instrumentNow() : 0) {
+			entries[id].calls++;
+			total.fetch_add(1, memory_order_relaxed);
+		}
+		~Scope () {
+			if (!timing && !trace)
+				return;
+			double end = instrumentNow();
+			entries[id].seconds += end - start;
+			if (trace)
+				record(id, start, end);
+		}
+	};
+
+	static R call (A... args) {
+		Scope scope;
+		return real(args...);
+	}
+
+	static void install (const char *name) {
+		if (!*slot)
+			return;		// not provided by this context
+		id = entries.size();
+		Entry e = { name, 0, 0 };
+		entries.push_back(e);
+		real = *slot;
+		*slot = call;
+	}
+};
+
+template <typename R, typename... A, R (**slot)(A...)>
+R (*Hook<R (*)(A...), slot>::real)(A...);
+template <typename R, typename... A, R (**slot)(A...)>
+int Hook<R (*)(A...), slot>::id;
+
+#define TRACE(name) Hook<decltype(glad_##name), &glad_##name>::install(#name);
+
+void glTraceInstall (bool with_timing, const char *path)
+{
+	if (active)
+		return;
+	timing = with_timing;
+	origin = instrumentNow();
+	// Per-frame drawing first, then resource creation and state setup
+	TRACE(glClear) TRACE(glUseProgram) TRACE(glUniformMatrix4fv) TRACE(glPolygonMode)
+	TRACE(glBindVertexArray) TRACE(glEnableVertexAttribArray) TRACE(glBindBuffer)
+	TRACE(glDrawArrays) TRACE(glViewport) TRACE(glEnable) TRACE(glDisable)
+	TRACE(glBufferData) TRACE(glBufferSubData) TRACE(glVertexAttribPointer)
+	TRACE(glGenBuffers) TRACE(glGenVertexArrays) TRACE(glDeleteBuffers) TRACE(glDeleteVertexArrays)
+	TRACE(glBindTexture) TRACE(glBlendFunc) TRACE(glUniform1i)
+	TRACE(glUniform1f) TRACE(glUniform2f) TRACE(glUniform3f) TRACE(glBindFramebuffer)
+	active = true;
+
+	if (path && !(trace = fopen(path, "wb")))
+		perror(path);
+	if (trace) {
+		uint32_t count = entries.size();
+		fwrite(TRACE_MAGIC, 1, 4, trace);
+		fwrite(&TRACE_VERSION, sizeof TRACE_VERSION, 1, trace);
+		fwrite(&count, sizeof count, 1, trace);
+		for (size_t i=0; i<entries.size(); i++) {
+			uint8_t length = strlen(entries[i].name);
+			fwrite(&length, 1, 1, trace);
+			fwrite(entries[i].name, 1, length, trace);
+		}
+	}
+}
+
+bool glTraceActive ()
+{
+	return active;
+}
+
+void glTraceFrame ()
+{
+	if (!active)
+		return;
+	frames.fetch_add(1, memory_order_relaxed);
+	if (trace) {
+		double now = instrumentNow();
+		record(FRAME_MARK, now, now);
+	}
+}
+
+long glTraceCalls ()
+{
+	return total.load(memory_order_relaxed);
+}
+
+void glTraceReport ()
+{
+	if (!active)
+		return;
+	vector<Entry> sorted(entries);
+	sort(sorted.begin(), sorted.end(), [](const Entry &a, const Entry &b) { return a.calls > b.calls; });
+	long calls = total, frame_count = frames;
+	double per = frame_count ? 1.0/frame_count : 1.0;
+	instrumentNote("gl calls: %ld total, %.1f per frame over %ld frames", calls, calls*per, frame_count);
+	for (size_t i=0; i<sorted.size() && sorted[i].calls; i++) {
+		if (timing)
+			instrumentNote("  %-26s %9.1f/frame %9.1f us/frame", sorted[i].name,
+					sorted[i].calls*per, sorted[i].seconds*per*1e6);
+		else
+			instrumentNote("  %-26s %9.1f/frame", sorted[i].name, sorted[i].calls*per);
+	}
+	if (trace) {
+		flush();
+		fclose(trace);
+		trace = NULL;
+	}
+}
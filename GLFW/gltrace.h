@@ -0,0 +1,30 @@
+#ifndef GLTRACE_H
+#define GLTRACE_H
+
+#include <stdio.h>
+
+/* Optional GL call tracing. glTraceInstall() swaps glad's function
+   pointers for wrappers that count calls per entry point, optionally time
+   them, and optionally append a compact binary trace to a file. The game
+   calls it right after gladLoadGLLoader() when SAMPLE2D_GLTRACE is set:
+   "count", "time", or a file name to also write the trace. */
+
+/* Wrap the traced entry points. 'timing' measures each call's duration;
+   'path' (may be NULL) receives the binary trace. */
+void glTraceInstall (bool timing, const char *path);
+
+bool glTraceActive ();
+
+/* Mark the end of a frame: per-frame statistics, a frame record in the trace */
+void glTraceFrame ();
+
+/* Calls through traced entry points since installation; safe to call
+   while the render thread is drawing */
+long glTraceCalls ();
+
+/* Per entry point calls and time per frame, via instrumentNote; closes the
+   trace. Call it only once the render thread has stopped (Renderer.stop()):
+   the per entry point counters are not synchronized. */
+void glTraceReport ();
+
+#endif
@@ -0,0 +1,75 @@
+#include "instrument.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <string>
+#include <time.h>
+#include <vector>
+
+using namespace std;
+
+struct Phase {
+	string name;
+	double seconds;
+};
+
+static vector<Phase> phases;
+static vector<string> notes;
+static double first_frame = -1;
+
+double instrumentNow ()
+{
+	// Set on the first call, so globals in other files may call this from
+	// their initializers whatever order the files are initialized in
+	static const chrono::steady_clock::time_point process_start = chrono::steady_clock::now();
+	return chrono::duration<double>(chrono::steady_clock::now() - process_start).count();
+}
+
+// With no earlier caller, the first call is this one, before main() runs
+static const double started = instrumentNow();
+
+double instrumentThreadCPU ()
+{
+	struct timespec now;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now) != 0)
+		return instrumentNow();
+	return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+void instrumentFirstFrame ()
+{
+	if (first_frame < 0)
+		first_frame = instrumentNow();
+}
+
+void instrumentPhase (const char *name, double seconds)
+{
+	Phase phase = { name, seconds };
+	phases.push_back(phase);
+}
+
+void instrumentNote (const char *fmt, ...)
+{
+	char line[256];
+	va_list args;
+	va_start(args, fmt);
+	vsnprintf(line, sizeof line, fmt, args);
+	va_end(args);
+	notes.push_back(line);
+}
+
+void instrumentReport (FILE *out)
+{
+	double total = 0;
+	fprintf(out, "---- instrumentation ----\n");
+	fprintf(out, "startup:\n");
+	for (size_t i=0; i<phases.size(); i++) {
+		fprintf(out, "  %-24s %9.3f ms\n", phases[i].name.c_str(), phases[i].seconds*1000);
+		total += phases[i].seconds;
+	}
+	fprintf(out, "  %-24s %9.3f ms\n", "sum of phases", total*1000);
+	if (first_frame >= 0)
+		fprintf(out, "  %-24s %9.3f ms\n", "time to first frame", first_frame*1000);
+	for (size_t i=0; i<notes.size(); i++)
+		fprintf(out, "%s\n", notes[i].c_str());
+}
@@ -0,0 +1,25 @@
+#ifndef INSTRUMENT_H
+#define INSTRUMENT_H
+
+#include <cstdio>
+
+/* Monotonic wall clock in seconds since process start, usable before
+   glfwInit() and from static initializers */
+double instrumentNow ();
+
+/* CPU time used by the calling thread, in seconds */
+double instrumentThreadCPU ();
+
+/* Record how long one named startup phase took */
+void instrumentPhase (const char *name, double seconds);
+
+/* Mark the end of startup; the report shows time-to-first-frame from process start */
+void instrumentFirstFrame ();
+
+/* Attach a one-line note to the report (cache hits, driver strings, ...) */
+void instrumentNote (const char *fmt, ...);
+
+/* Print everything collected so far */
+void instrumentReport (FILE *out);
+
+#endif
@@ -0,0 +1,119 @@
+#include "jobs.h"
+
+using namespace std;
+
+// Index of the worker running on this thread, -1 outside the job system
+static thread_local int worker = -1;
+
+JobSystem::JobSystem ()
+{
+	queued = 0;
+	quitting = false;
+}
+
+JobSystem::~JobSystem ()
+{
+	stop();
+}
+
+void JobSystem::start (int threads)
+{
+	stop();
+	if (threads <= 0)
+		threads = max(1u, thread::hardware_concurrency());
+	quitting = false;
+	for (int t=0; t<threads; t++)
+		queues.push_back(unique_ptr<WorkQueue>(new WorkQueue));
+	worker = 0;
+	for (int t=1; t<threads; t++)
+		workers.push_back(thread(&JobSystem::work, this, t));
+}
+
+void JobSystem::stop ()
+{
+	{
+		lock_guard<mutex> hold(sleep_lock);
+		quitting = true;
+	}
+	wake.notify_all();
+	for (size_t t=0; t<workers.size(); t++)
+		workers[t].join();
+	workers.clear();
+	queues.clear();
+}
+
+void JobSystem::run (Job job, JobCounter &counter)
+{
+	job.counter = &counter;
+	counter.pending++;
+	// Outside start() there is nobody to hand the job to
+	if (worker < 0 || queues.size() <= 1) {
+		execute(job);
+		return;
+	}
+	{
+		lock_guard<mutex> hold(queues[worker]->lock);
+		queues[worker]->jobs.push_back(job);
+	}
+	queued++;
+	{
+		lock_guard<mutex> hold(sleep_lock);
+	}
+	wake.notify_one();
+}
+
+/* Own queue newest first, then the oldest job of the others */
+bool JobSystem::next (int self, Job &job)
+{
+	int n = queues.size();
+	for (int k=0; k<n; k++) {
+		WorkQueue &q = *queues[(self + k) % n];
+		lock_guard<mutex> hold(q.lock);
+		if (q.jobs.empty())
+			continue;
+		if (k == 0) {
+			job = q.jobs.back();
+			q.jobs.pop_back();
+		}
+		else {
+			job = q.jobs.front();
+			q.jobs.pop_front();
+		}
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+void JobSystem::execute (const Job &job)
+{
+	job.run(job.data, job.begin, job.end);
+	job.counter->pending--;
+}
+
+void JobSystem::wait (JobCounter &counter)
+{
+	Job job;
+	while (counter.pending > 0) {
+		if (worker >= 0 && next(worker, job))
+			execute(job);
+		else
+			this_thread::yield();
+	}
+}
+
+void JobSystem::work (int self)
+{
+	worker = self;
+	Job job;
+	for (;;) {
+		if (next(self, job)) {
+			execute(job);
+			continue;
+		}
+		unique_lock<mutex> hold(sleep_lock);
+		wake.wait(hold, [this] { return queued > 0 || quitting; });
+		if (quitting)
+			return;
+	}
+}
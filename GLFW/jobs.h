@@ -0,0 +1,85 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Work-stealing job scheduler for per-frame parallel work. Every thread
+   owns a deque: it pushes and pops its own jobs at the back and steals
+   from the front of the others' when it runs dry. The thread that called
+   start() is worker 0 and helps while it waits, so start(1) runs every job
+   inline. Jobs may only be queued from that thread or from inside jobs. */
+
+/* Outstanding jobs of one batch; wait() returns once it drops to zero */
+struct JobCounter {
+	std::atomic<int> pending;
+	JobCounter () : pending(0) {}
+};
+
+struct Job {
+	void (*run) (void *data, int begin, int end);
+	void *data;
+	int begin, end;
+	JobCounter *counter;
+};
+
+struct JobSystem {
+	JobSystem ();
+	~JobSystem ();
+
+	/* 'threads' counts the calling thread; 0 picks one per hardware thread */
+	void start (int threads);
+	void stop ();
+	int threads () const { return (int)queues.size(); }
+
+	/* Queue 'job', counted against 'counter' */
+	void run (Job job, JobCounter &counter);
+
+	/* Run queued jobs until 'counter' reaches zero */
+	void wait (JobCounter &counter);
+
+	/* Split [begin,end) into chunks of at most 'grain' and call
+	   body(chunk_begin, chunk_end) for each, in parallel; returns when all are done */
+	template <typename F>
+	void parallelFor (int begin, int end, int grain, const F &body) {
+		if (threads() <= 1 || end - begin <= grain) {
+			if (begin < end)
+				body(begin, end);
+			return;
+		}
+		JobCounter counter;
+		for (int b=begin; b<end; b+=grain) {
+			Job job = { call<F>, (void*)&body, b, b+grain < end ? b+grain : end, NULL };
+			run(job, counter);
+		}
+		wait(counter);
+	}
+
+private:
+	struct WorkQueue {
+		std::mutex lock;
+		std::deque<Job> jobs;
+	};
+	std::vector< std::unique_ptr<WorkQueue> > queues;
+	std::vector<std::thread> workers;
+	std::mutex sleep_lock;
+	std::condition_variable wake;
+	std::atomic<int> queued;
+	bool quitting;
+
+	template <typename F>
+	static void call (void *body, int begin, int end) {
+		(*(const F*)body)(begin, end);
+	}
+
+	bool next (int self, Job &job);
+	void execute (const Job &job);
+	void work (int self);
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "level.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+/* Same as levels/default.txt, so the game runs without any level files */
+static const char DefaultLevelText[] =
+	"name default\n"
+	"basket red   -3.15  -3  2.9\n"
+	"basket green  2.85  -2  4.2\n"
+	"cannon -7.6 0.65 -2.5 2.9 70\n"
+	"catch 0.35 -6.3 -7 -8\n"
+	"spawn -4 12 0  1 1 0  1 0 2\n"
+	"speed 1.2 100 1 3 1.6 0.02\n"
+	"mirror  5.5  2.5 135 0.2 0.9\n"
+	"mirror  5   -1.2  45 0.2 0.9\n"
+	"mirror -3    2   135 0.2 0.9\n"
+	"mirror -1.1 -1.4  45 0.2 0.9\n";
+
+struct Mapping {
+	void *address;
+	size_t length;
+};
+static vector<Mapping> mappings;
+
+bool levelParse (const char *text, LevelData *level, char *error, int error_size)
+{
+	memset(level, 0, sizeof *level);
+	level->magic = LEVEL_MAGIC;
+	level->version = LEVEL_VERSION;
+
+	int line_number = 0;
+	while (*text) {
+		char line[256];
+		size_t length = strcspn(text, "\n");
+		if (length >= sizeof line)
+			length = sizeof line - 1;
+		memcpy(line, text, length);
+		line[length] = '\0';
+		text += strcspn(text, "\n");
+		if (*text)
+			text++;
+		line_number++;
+
+		char *comment = strchr(line, '#');
+		if (comment)
+			*comment = '\0';
+		char key[16], color[16];
+		if (sscanf(line, "%15s", key) != 1)
+			continue;
+
+		bool ok = false;
+		if (!strcmp(key, "name"))
+			ok = sscanf(line, "%*s %31s", level->name) == 1;
+		else if (!strcmp(key, "basket")) {
+			LevelBasket basket;
+			ok = sscanf(line, "%*s %15s %f %f %f", color, &basket.x, &basket.min, &basket.max) == 4;
+			if (ok && !strcmp(color, "red"))
+				level->red = basket;
+			else if (ok && !strcmp(color, "green"))
+				level->green = basket;
+			else
+				ok = false;
+		}
+		else if (!strcmp(key, "cannon")) {
+			LevelCannon &c = level->cannon;
+			ok = sscanf(line, "%*s %f %f %f %f %f", &c.x, &c.y, &c.min, &c.max, &c.tilt) == 5;
+		}
+		else if (!strcmp(key, "catch")) {
+			LevelCatch &c = level->catchzone;
+			ok = sscanf(line, "%*s %f %f %f %f", &c.halfwidth, &c.top, &c.bottom, &c.miss) == 4;
+		}
+		else if (!strcmp(key, "spawn")) {
+			LevelSpawn &s = level->spawn;
+			ok = sscanf(line, "%*s %d %d %f %d %d %d %d %d %d", &s.xmin, &s.xcount, &s.split,
+					&s.left[0], &s.left[1], &s.left[2], &s.right[0], &s.right[1], &s.right[2]) == 9
+				&& s.xcount > 0
+				&& s.left[0]+s.left[1]+s.left[2] > 0 && s.right[0]+s.right[1]+s.right[2] > 0;
+		}
+		else if (!strcmp(key, "speed")) {
+			LevelSpeed &s = level->speed;
+			ok = sscanf(line, "%*s %f %d %f %f %f %f", &s.growth, &s.step, &s.min, &s.max, &s.interval, &s.fall) == 6
+				&& s.step > 0;
+		}
+		else if (!strcmp(key, "mirror")) {
+			if (level->mirror_count < LEVEL_MAX_MIRRORS) {
+				LevelMirror &m = level->mirrors[level->mirror_count];
+				ok = sscanf(line, "%*s %f %f %f %f %f", &m.x, &m.y, &m.angle, &m.back, &m.front) == 5;
+				// Direction is stored so the game never needs trig for mirrors
+				m.dx = cos(m.angle*M_PI/180);
+				m.dy = sin(m.angle*M_PI/180);
+				level->mirror_count++;
+			}
+		}
+		if (!ok) {
+			snprintf(error, error_size, "line %d: bad '%s' entry", line_number, key);
+			return false;
+		}
+	}
+	if (level->spawn.xcount == 0 || level->speed.step == 0) {
+		snprintf(error, error_size, "missing 'spawn' or 'speed' entry");
+		return false;
+	}
+	return true;
+}
+
+const LevelData* levelMap (const char *path)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size != (off_t) sizeof(LevelData)) {
+		close(fd);
+		return NULL;
+	}
+	void *address = mmap(NULL, sizeof(LevelData), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (address == MAP_FAILED)
+		return NULL;
+
+	const LevelData *level = (const LevelData *) address;
+	if (level->magic != LEVEL_MAGIC || level->version != LEVEL_VERSION
+			|| level->mirror_count > LEVEL_MAX_MIRRORS) {
+		munmap(address, sizeof(LevelData));
+		return NULL;
+	}
+	Mapping mapping = { address, sizeof(LevelData) };
+	mappings.push_back(mapping);
+	return level;
+}
+
+const LevelData* levelDefault ()
+{
+	static LevelData level;
+	static bool parsed = false;
+	if (!parsed) {
+		char error[128];
+		levelParse(DefaultLevelText, &level, error, sizeof error);
+		parsed = true;
+	}
+	return &level;
+}
+
+void levelUnmapAll ()
+{
+	for (size_t i=0; i<mappings.size(); i++)
+		munmap(mappings[i].address, mappings[i].length);
+	mappings.clear();
+}
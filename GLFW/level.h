@@ -0,0 +1,81 @@
+#ifndef LEVEL_H
+#define LEVEL_H
+
+#include <stdint.h>
+
+/* Binary level layout. A .lvl file is exactly one LevelData, written by
+   levelc from a text description and mmap()ed read-only by the game, so
+   it must stay plain-old-data with fixed-size members. Bump
+   LEVEL_VERSION whenever the layout changes. */
+
+#define LEVEL_MAGIC 0x4c56454cu		// "LEVL"
+#define LEVEL_VERSION 1
+#define LEVEL_MAX_MIRRORS 16
+
+enum BrickColor { BRICK_BLACK, BRICK_RED, BRICK_GREEN, BRICK_COLORS };
+
+struct LevelMirror {
+	float x, y;			// pivot, as passed to glm::translate
+	float angle;		// degrees
+	float dx, dy;		// unit direction of the mirror surface, precomputed by levelc
+	float back, front;	// extent behind and in front of the pivot along (dx,dy)
+};
+
+struct LevelBasket {
+	float x;			// x offset of the basket at position 0
+	float min, max;		// clamp range of the basket position
+};
+
+struct LevelCannon {
+	float x, y;			// barrel pivot
+	float min, max;		// clamp range of the vertical position
+	float tilt;			// maximum tilt either way, degrees
+};
+
+struct LevelCatch {
+	float halfwidth;	// |basket x - brick x| that still counts as a catch
+	float top, bottom;	// brick offsets between which a basket catches
+	float miss;			// brick offset at which it is lost
+};
+
+struct LevelSpawn {
+	int32_t xmin, xcount;			// brick x = xmin + [0, xcount), see spawn.h
+	float split;					// x at or below which the 'left' weights apply
+	int32_t left[BRICK_COLORS];		// relative color weights left of split
+	int32_t right[BRICK_COLORS];	// ... and right of it
+};
+
+struct LevelSpeed {
+	float growth;		// speed multiplier per 'step' points of score
+	int32_t step;
+	float min, max;		// clamp range of the speed
+	float interval;		// seconds between spawns at speed 1
+	float fall;			// brick fall per tick at speed 1
+};
+
+struct LevelData {
+	uint32_t magic;
+	uint32_t version;
+	char name[32];
+	LevelBasket red, green;
+	LevelCannon cannon;
+	LevelCatch catchzone;
+	LevelSpawn spawn;
+	LevelSpeed speed;
+	uint32_t mirror_count;
+	LevelMirror mirrors[LEVEL_MAX_MIRRORS];
+};
+
+/* Parse the text form; on failure returns false with a message in 'error' */
+bool levelParse (const char *text, LevelData *level, char *error, int error_size);
+
+/* Map a .lvl file read-only; returns NULL if it is missing or invalid */
+const LevelData* levelMap (const char *path);
+
+/* The built-in level, used when no level file could be mapped */
+const LevelData* levelDefault ();
+
+/* Unmap every level mapped so far */
+void levelUnmapAll ();
+
+#endif
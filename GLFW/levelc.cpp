@@ -0,0 +1,46 @@
+/* levelc - convert a text level description into the binary .lvl
+   format the game maps at startup.
+
+   usage: levelc level.txt level.lvl */
+
+#include "level.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace std;
+
+int main (int argc, char** argv)
+{
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s level.txt level.lvl\n", argv[0]);
+		return 1;
+	}
+
+	FILE *in = fopen(argv[1], "r");
+	if (!in) {
+		perror(argv[1]);
+		return 1;
+	}
+	string text;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof buffer, in)) > 0)
+		text.append(buffer, n);
+	fclose(in);
+
+	LevelData level;
+	char error[128];
+	if (!levelParse(text.c_str(), &level, error, sizeof error)) {
+		fprintf(stderr, "%s: %s\n", argv[1], error);
+		return 1;
+	}
+
+	FILE *out = fopen(argv[2], "wb");
+	if (!out || fwrite(&level, sizeof level, 1, out) != 1) {
+		perror(argv[2]);
+		return 1;
+	}
+	fclose(out);
+	return 0;
+}
@@ -0,0 +1,89 @@
+#include "pacer.h"
+#include "instrument.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+static const size_t History = 600;	// samples kept for statistics (~10 s at 60 Hz)
+static const size_t Window = 31;	// recent intervals used to estimate the refresh period
+
+FramePacer::FramePacer ()
+{
+	refresh = 1.0/60;
+	work = 0.004;
+	margin = 0.002;
+	last_present = -1;
+	input_time = 0;
+	slept = 0;
+	missed = 0;
+	enabled = true;
+}
+
+void FramePacer::resync ()
+{
+	last_present = -1;
+}
+
+void FramePacer::waitForInput ()
+{
+	if (enabled && last_present >= 0) {
+		double target = last_present + refresh - work - margin;
+		double now = instrumentNow();
+		if (target > now) {
+			this_thread::sleep_for(chrono::duration<double>(target - now));
+			slept += target - now;
+		}
+	}
+	input_time = instrumentNow();
+}
+
+static void push (vector<double> &samples, double value)
+{
+	if (samples.size() == History)
+		samples.erase(samples.begin());
+	samples.push_back(value);
+}
+
+void FramePacer::completed (double input, double swap, double present)
+{
+	// Exponential average, biased upwards so one slow frame moves it quickly
+	double sample = swap - input;
+	work += (sample > work ? 0.5 : 0.05) * (sample - work);
+
+	push(latencies, present - input);
+	if (last_present >= 0) {
+		double interval = present - last_present;
+		push(intervals, interval);
+		if (interval > 1.5*refresh)
+			missed++;
+
+		// Median of the recent intervals, so missed frames do not skew it
+		size_t n = min(intervals.size(), Window);
+		vector<double> recent(intervals.end() - n, intervals.end());
+		nth_element(recent.begin(), recent.begin() + n/2, recent.end());
+		refresh = max(1.0/240, min(1.0/30, recent[n/2]));
+	}
+	last_present = present;
+}
+
+static double percentile (vector<double> samples, double p)
+{
+	if (samples.empty())
+		return 0;
+	size_t k = min(samples.size() - 1, (size_t)(p * samples.size()));
+	nth_element(samples.begin(), samples.begin() + k, samples.end());
+	return samples[k];
+}
+
+void FramePacer::report ()
+{
+	instrumentNote("present interval: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, %ld missed, refresh %.2f Hz",
+			percentile(intervals, 0.50)*1000, percentile(intervals, 0.95)*1000,
+			percentile(intervals, 0.99)*1000, missed, 1/refresh);
+	instrumentNote("input-to-present latency: p50 %.2f ms, p95 %.2f ms, p99 %.2f ms, %.0f ms slept before input",
+			percentile(latencies, 0.50)*1000, percentile(latencies, 0.95)*1000,
+			percentile(latencies, 0.99)*1000, slept*1000);
+}
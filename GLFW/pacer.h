@@ -0,0 +1,40 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <vector>
+
+/* Frame pacing. Measures the real interval between presents, estimates how
+   long a frame takes from input sampling to swap, and sleeps before
+   sampling input so the frame is produced just ahead of the next vblank
+   instead of waiting in the swap with stale input. */
+struct FramePacer {
+	double refresh;			// estimated present period, seconds
+	double work;			// smoothed input-to-swap CPU time
+	double margin;			// slack kept before the deadline
+	double last_present;	// -1 until the first present after a resync
+	double input_time;		// when input was sampled for the frame in flight
+	double slept;
+	long missed;
+	std::vector<double> intervals;
+	std::vector<double> latencies;
+	bool enabled;
+
+	FramePacer ();
+
+	/* Forget timing history, e.g. after the loop slept waiting for events */
+	void resync ();
+
+	/* Sleep until input should be sampled, then mark the sample time */
+	void waitForInput ();
+
+	/* A frame whose input was sampled at 'input' started its swap at 'swap'
+	   and the swap returned at 'present' (instrumentNow() times). With the
+	   render thread this arrives a frame late, which keeps the pacer from
+	   sleeping: pipelined frames trade latency for throughput anyway. */
+	void completed (double input, double swap, double present);
+
+	/* Percentile summaries for the instrumentation report */
+	void report ();
+};
+
+#endif
@@ -0,0 +1,76 @@
+#include "platform.h"
+
+#include <glad/glad.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+using namespace std;
+
+/* Defined by the backend files; the Makefile passes WITH_<NAME> for each one built */
+#ifdef WITH_GLFW
+Platform *createGlfwPlatform (bool visible);
+static Platform *createGlfw () { return createGlfwPlatform(true); }
+static Platform *createOffscreen () { return createGlfwPlatform(false); }
+#endif
+#ifdef WITH_GLUT
+Platform *createGlutPlatform ();
+#endif
+#ifdef WITH_EGL
+Platform *createEglPlatform ();
+#endif
+
+struct Backend {
+	const char *name;
+	Platform *(*create) ();
+	bool visible;
+};
+
+static const Backend Backends[] = {
+#ifdef WITH_GLFW
+	{ "glfw", createGlfw, true },
+	{ "offscreen", createOffscreen, false },
+#endif
+#ifdef WITH_GLUT
+	{ "glut", createGlutPlatform, true },
+#endif
+#ifdef WITH_EGL
+	{ "headless", createEglPlatform, false },
+#endif
+	{ NULL, NULL, false }
+};
+
+Platform *platformCreate (const char *name)
+{
+	for (const Backend *b = Backends; b->name; b++)
+		if (!strcmp(b->name, name))
+			return b->create();
+	return NULL;
+}
+
+const char *platformDefault (bool visible)
+{
+	for (const Backend *b = Backends; b->name; b++)
+		if (b->visible == visible)
+			return b->name;
+	return Backends[0].name;
+}
+
+const char *platformList ()
+{
+	static string list;
+	if (list.empty())
+		for (const Backend *b = Backends; b->name; b++)
+			list += string(list.empty() ? "" : ", ") + b->name;
+	return list.c_str();
+}
+
+bool platformLoadGL (void *(*lookup) (const char *name))
+{
+	if (!gladLoadGLLoader((GLADloadproc) lookup)) {
+		fprintf(stderr, "platform: cannot load the OpenGL entry points\n");
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,85 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+/* Window system backends behind one interface, so the renderer and the
+   simulation run unchanged on any of them:
+
+     glfw       a GLFW window (the default for play)
+     offscreen  a hidden GLFW window (the default for --scene and --replay)
+     glut       a freeglut window
+     headless   an EGL pbuffer, no window system or display at all
+
+   Each backend is compiled in by its own file (platformglfw.cpp, ...)
+   and the Makefile's PLATFORMS list. Every backend opens a GL 3.3 core
+   context and loads glad before returning from open(). */
+
+/* Key codes follow GLFW's: printable keys are their uppercase ASCII code */
+enum PlatformKey {
+	KEY_SPACE = 32,
+	KEY_ESCAPE = 256, KEY_ENTER = 257,
+	KEY_RIGHT = 262, KEY_LEFT = 263, KEY_DOWN = 264, KEY_UP = 265,
+	KEY_LEFT_CONTROL = 341, KEY_LEFT_ALT = 342, KEY_RIGHT_CONTROL = 345, KEY_RIGHT_ALT = 346
+};
+
+enum PlatformAction { ACTION_RELEASE = 0, ACTION_PRESS = 1, ACTION_REPEAT = 2 };
+
+enum PlatformButton { BUTTON_LEFT = 0, BUTTON_RIGHT = 1, BUTTON_MIDDLE = 2 };
+
+/* Input and window events, delivered from pollEvents() and waitEvents().
+   Sizes are in screen coordinates; any of these may be NULL. */
+struct PlatformCallbacks {
+	void (*reshape) (int width, int height);
+	void (*refresh) ();		// contents damaged, redraw
+	void (*close) ();
+	void (*key) (int key, int action);
+	void (*character) (unsigned int codepoint);
+	void (*mouseButton) (int button, int action);
+	void (*scroll) (double yoffset);
+};
+
+struct Platform {
+	PlatformCallbacks on;
+
+	Platform () : on() {}
+	virtual ~Platform () {}
+
+	virtual const char *name () const = 0;
+
+	/* Create the window or surface with a current context; false on failure */
+	virtual bool open (int width, int height, const char *title) = 0;
+	virtual void close () = 0;
+
+	virtual void pollEvents () = 0;
+	/* Block until an event arrives or 'timeout' seconds pass */
+	virtual void waitEvents (double timeout) = 0;
+	virtual bool shouldClose () = 0;
+
+	/* 0 off, 1 vsync, -1 adaptive (late frames tear); false when unsupported */
+	virtual bool swapInterval (int interval) = 0;
+	virtual void swapBuffers () = 0;
+
+	/* Bind or release the context on the calling thread. false when the
+	   context cannot move to another thread, as with GLUT */
+	virtual bool makeCurrent (bool current) = 0;
+	/* Whether the context is current on the calling thread */
+	virtual bool current () = 0;
+
+	virtual void windowSize (int &width, int &height) = 0;
+	/* In pixels; differs from the window size on HiDPI screens */
+	virtual void framebufferSize (int &width, int &height) = 0;
+	virtual void cursorPos (double &x, double &y) = 0;
+};
+
+/* The backend called 'name', NULL when it is not compiled in */
+Platform *platformCreate (const char *name);
+
+/* First compiled-in backend suitable for play (visible) or benchmarks */
+const char *platformDefault (bool visible);
+
+/* Names of the compiled-in backends, comma separated */
+const char *platformList ();
+
+/* Load the GL entry points through the backend's lookup; prints why on failure */
+bool platformLoadGL (void *(*lookup) (const char *name));
+
+#endif
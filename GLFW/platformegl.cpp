@@ -0,0 +1,132 @@
+#include "platform.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <stdio.h>
+#include <time.h>
+
+static void *lookup (const char *name)
+{
+	return (void*) eglGetProcAddress(name);
+}
+
+/* Renders into a pbuffer: no window system, no display server, no input.
+   Mesa's surfaceless platform is used where present, so this runs on a
+   bare machine with llvmpipe. */
+struct EglPlatform : Platform {
+	EGLDisplay display;
+	EGLSurface surface;
+	EGLContext context;
+	int width, height;
+
+	EglPlatform () : display(EGL_NO_DISPLAY), surface(EGL_NO_SURFACE), context(EGL_NO_CONTEXT), width(0), height(0) {}
+	~EglPlatform () { close(); }
+
+	const char *name () const { return "headless"; }
+
+	static EGLDisplay surfaceless () {
+		PFNEGLGETPLATFORMDISPLAYEXTPROC platformDisplay =
+			(PFNEGLGETPLATFORMDISPLAYEXTPROC) eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (!platformDisplay)
+			return EGL_NO_DISPLAY;
+		return platformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+
+	bool fail (const char *what) {
+		fprintf(stderr, "headless: %s failed (EGL error 0x%x)\n", what, eglGetError());
+		close();
+		return false;
+	}
+
+	bool open (int w, int h, const char * /*title*/) {
+		EGLint major, minor;
+		display = surfaceless();
+		if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+			display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+			if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+				return fail("eglInitialize");
+		}
+		if (!eglBindAPI(EGL_OPENGL_API))
+			return fail("eglBindAPI");
+
+		const EGLint config_attribs[] = {
+			EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+			EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+			EGL_DEPTH_SIZE, 24, EGL_NONE
+		};
+		EGLConfig config;
+		EGLint configs = 0;
+		if (!eglChooseConfig(display, config_attribs, &config, 1, &configs) || configs == 0)
+			return fail("eglChooseConfig");
+
+		const EGLint surface_attribs[] = { EGL_WIDTH, w, EGL_HEIGHT, h, EGL_NONE };
+		surface = eglCreatePbufferSurface(display, config, surface_attribs);
+		if (surface == EGL_NO_SURFACE)
+			return fail("eglCreatePbufferSurface");
+
+		const EGLint context_attribs[] = {
+			EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+			EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE
+		};
+		context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attribs);
+		if (context == EGL_NO_CONTEXT)
+			return fail("eglCreateContext");
+		if (!makeCurrent(true))
+			return fail("eglMakeCurrent");
+		width = w;
+		height = h;
+		if (!platformLoadGL(lookup)) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close () {
+		if (display == EGL_NO_DISPLAY)
+			return;
+		eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (context != EGL_NO_CONTEXT)
+			eglDestroyContext(display, context);
+		if (surface != EGL_NO_SURFACE)
+			eglDestroySurface(display, surface);
+		eglTerminate(display);
+		display = EGL_NO_DISPLAY;
+		surface = EGL_NO_SURFACE;
+		context = EGL_NO_CONTEXT;
+	}
+
+	// Nothing ever arrives
+	void pollEvents () {}
+	void waitEvents (double timeout) {
+		struct timespec nap = { (time_t) timeout, (long) ((timeout - (time_t) timeout) * 1e9) };
+		nanosleep(&nap, NULL);
+	}
+	bool shouldClose () { return false; }
+
+	bool swapInterval (int interval) { return interval >= 0 && eglSwapInterval(display, interval); }
+
+	/* A pbuffer has nothing to show: wait for the frame instead, so frame
+	   times include rendering as they would with a real swap */
+	void swapBuffers () {
+		eglSwapBuffers(display, surface);
+		eglWaitClient();
+	}
+
+	bool makeCurrent (bool current) {
+		if (current)
+			return eglMakeCurrent(display, surface, surface, context);
+		return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	}
+	bool current () { return context != EGL_NO_CONTEXT && eglGetCurrentContext() == context; }
+
+	void windowSize (int &w, int &h) { w = width; h = height; }
+	void framebufferSize (int &w, int &h) { w = width; h = height; }
+	void cursorPos (double &x, double &y) { x = width/2; y = height/2; }
+};
+
+Platform *createEglPlatform ()
+{
+	return new EglPlatform();
+}
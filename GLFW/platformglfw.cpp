@@ -0,0 +1,135 @@
+#include "platform.h"
+
+#include <GLFW/glfw3.h>
+
+#include <stdio.h>
+
+// Key codes and actions pass through untranslated
+static_assert(KEY_UP == GLFW_KEY_UP && KEY_RIGHT_ALT == GLFW_KEY_RIGHT_ALT && KEY_ENTER == GLFW_KEY_ENTER,
+		"platform key codes must match GLFW's");
+static_assert(ACTION_PRESS == GLFW_PRESS && BUTTON_RIGHT == GLFW_MOUSE_BUTTON_RIGHT,
+		"platform actions and buttons must match GLFW's");
+
+static void errorCallback (int /*error*/, const char* description)
+{
+	fprintf(stderr, "Error: %s\n", description);
+}
+
+static void *lookup (const char *name)
+{
+	return (void*) glfwGetProcAddress(name);
+}
+
+struct GlfwPlatform : Platform {
+	GLFWwindow *window;
+	bool visible;
+
+	GlfwPlatform (bool show) : window(NULL), visible(show) {}
+	~GlfwPlatform () { close(); }
+
+	const char *name () const { return visible ? "glfw" : "offscreen"; }
+
+	static Platform *self (GLFWwindow *window) { return (Platform*) glfwGetWindowUserPointer(window); }
+
+	/* GLFW callbacks forward to the platform's; the window carries the platform */
+	static void reshape (GLFWwindow *window, int width, int height) {
+		if (self(window)->on.reshape)
+			self(window)->on.reshape(width, height);
+	}
+	static void refresh (GLFWwindow *window) {
+		if (self(window)->on.refresh)
+			self(window)->on.refresh();
+	}
+	static void closing (GLFWwindow *window) {
+		if (self(window)->on.close)
+			self(window)->on.close();
+	}
+	static void key (GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/) {
+		if (self(window)->on.key)
+			self(window)->on.key(key, action);
+	}
+	static void character (GLFWwindow *window, unsigned int codepoint) {
+		if (self(window)->on.character)
+			self(window)->on.character(codepoint);
+	}
+	static void mouseButton (GLFWwindow *window, int button, int action, int /*mods*/) {
+		if (self(window)->on.mouseButton)
+			self(window)->on.mouseButton(button, action);
+	}
+	static void scroll (GLFWwindow *window, double /*xoffset*/, double yoffset) {
+		if (self(window)->on.scroll)
+			self(window)->on.scroll(yoffset);
+	}
+
+	bool open (int width, int height, const char *title) {
+		glfwSetErrorCallback(errorCallback);
+		if (!glfwInit())
+			return false;
+
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, visible);
+
+		window = glfwCreateWindow(width, height, title, NULL, NULL);
+		if (!window) {
+			glfwTerminate();
+			return false;
+		}
+		glfwSetWindowUserPointer(window, this);
+		glfwMakeContextCurrent(window);
+		if (!platformLoadGL(lookup)) {
+			close();
+			return false;
+		}
+
+		/* With Retina display on Mac OS X GLFW's FramebufferSize
+		   is different from WindowSize */
+		glfwSetFramebufferSizeCallback(window, reshape);
+		glfwSetWindowSizeCallback(window, reshape);
+		glfwSetWindowRefreshCallback(window, refresh);
+		glfwSetWindowCloseCallback(window, closing);
+		glfwSetKeyCallback(window, key);      // general keyboard input
+		glfwSetCharCallback(window, character);  // simpler specific character handling
+		glfwSetMouseButtonCallback(window, mouseButton);  // mouse button clicks
+		glfwSetScrollCallback(window, scroll);
+		return true;
+	}
+
+	void close () {
+		if (!window)
+			return;
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		window = NULL;
+	}
+
+	void pollEvents () { glfwPollEvents(); }
+	void waitEvents (double timeout) { glfwWaitEventsTimeout(timeout); }
+	bool shouldClose () { return glfwWindowShouldClose(window); }
+
+	bool swapInterval (int interval) {
+		if (interval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear")
+				&& !glfwExtensionSupported("GLX_EXT_swap_control_tear"))
+			return false;
+		glfwSwapInterval(interval);
+		return true;
+	}
+	void swapBuffers () { glfwSwapBuffers(window); }
+
+	bool makeCurrent (bool current) {
+		glfwMakeContextCurrent(current ? window : NULL);
+		return true;
+	}
+	bool current () { return window && glfwGetCurrentContext() == window; }
+
+	void windowSize (int &width, int &height) { glfwGetWindowSize(window, &width, &height); }
+	void framebufferSize (int &width, int &height) { glfwGetFramebufferSize(window, &width, &height); }
+	void cursorPos (double &x, double &y) { glfwGetCursorPos(window, &x, &y); }
+};
+
+Platform *createGlfwPlatform (bool visible)
+{
+	return new GlfwPlatform(visible);
+}
@@ -0,0 +1,180 @@
+#include "platform.h"
+
+#include <GL/freeglut.h>
+
+#include <ctype.h>
+#include <time.h>
+
+/* freeglut keeps its state in globals, so there is only ever one window
+   and its callbacks find the platform here */
+static struct GlutPlatform *Glut;
+
+static void *lookup (const char *name)
+{
+	return (void*) glutGetProcAddress(name);
+}
+
+struct GlutPlatform : Platform {
+	int window;
+	int width, height;
+	int cursorx, cursory;
+	bool closed, events;
+
+	GlutPlatform () : window(0), width(0), height(0), cursorx(0), cursory(0), closed(false), events(false) {}
+	~GlutPlatform () { close(); }
+
+	const char *name () const { return "glut"; }
+
+	/* Translate to GLFW's key codes: letters are uppercase, specials move to 256+ */
+	static int asciiKey (unsigned char c) {
+		if (c == 27)
+			return KEY_ESCAPE;
+		if (c == '\r' || c == '\n')
+			return KEY_ENTER;
+		return toupper(c);
+	}
+	static int specialKey (int key) {
+		switch (key) {
+			case GLUT_KEY_LEFT: return KEY_LEFT;
+			case GLUT_KEY_RIGHT: return KEY_RIGHT;
+			case GLUT_KEY_UP: return KEY_UP;
+			case GLUT_KEY_DOWN: return KEY_DOWN;
+			case GLUT_KEY_CTRL_L: return KEY_LEFT_CONTROL;
+			case GLUT_KEY_CTRL_R: return KEY_RIGHT_CONTROL;
+			case GLUT_KEY_ALT_L: return KEY_LEFT_ALT;
+			case GLUT_KEY_ALT_R: return KEY_RIGHT_ALT;
+			default: return -1;
+		}
+	}
+
+	static void moved (int x, int y) {
+		Glut->cursorx = x;
+		Glut->cursory = y;
+	}
+	static void sendKey (int key, int action, int x, int y) {
+		moved(x, y);
+		Glut->events = true;
+		if (key >= 0 && Glut->on.key)
+			Glut->on.key(key, action);
+	}
+	static void keyDown (unsigned char c, int x, int y) {
+		sendKey(asciiKey(c), ACTION_PRESS, x, y);
+		// GLFW sends characters only for printable keys
+		if (c >= ' ' && c != 127 && Glut->on.character)
+			Glut->on.character(c);
+	}
+	static void keyUp (unsigned char c, int x, int y) { sendKey(asciiKey(c), ACTION_RELEASE, x, y); }
+	static void specialDown (int key, int x, int y) { sendKey(specialKey(key), ACTION_PRESS, x, y); }
+	static void specialUp (int key, int x, int y) { sendKey(specialKey(key), ACTION_RELEASE, x, y); }
+
+	static void mouse (int button, int state, int x, int y) {
+		moved(x, y);
+		Glut->events = true;
+		int b = button == GLUT_LEFT_BUTTON ? BUTTON_LEFT : button == GLUT_RIGHT_BUTTON ? BUTTON_RIGHT
+			: button == GLUT_MIDDLE_BUTTON ? BUTTON_MIDDLE : -1;
+		if (b >= 0 && Glut->on.mouseButton)
+			Glut->on.mouseButton(b, state == GLUT_DOWN ? ACTION_PRESS : ACTION_RELEASE);
+	}
+	static void wheel (int /*wheel*/, int direction, int x, int y) {
+		moved(x, y);
+		Glut->events = true;
+		if (Glut->on.scroll)
+			Glut->on.scroll(direction);
+	}
+	static void reshape (int width, int height) {
+		Glut->width = width;
+		Glut->height = height;
+		Glut->events = true;
+		if (Glut->on.reshape)
+			Glut->on.reshape(width, height);
+	}
+	static void display () {
+		Glut->events = true;
+		if (Glut->on.refresh)
+			Glut->on.refresh();
+	}
+	static void closing () {
+		Glut->closed = true;
+		if (Glut->on.close)
+			Glut->on.close();
+	}
+
+	bool open (int w, int h, const char *title) {
+		int argc = 1;
+		char arg0[] = "sample2D", *argv[] = { arg0, NULL };
+		glutInit(&argc, argv);
+		glutInitContextVersion(3, 3);
+		glutInitContextProfile(GLUT_CORE_PROFILE);
+		glutInitContextFlags(GLUT_FORWARD_COMPATIBLE);
+		glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+		glutInitWindowSize(w, h);
+		window = glutCreateWindow(title);
+		if (window <= 0)
+			return false;
+		width = w;
+		height = h;
+		Glut = this;
+		if (!platformLoadGL(lookup)) {
+			close();
+			return false;
+		}
+
+		// Closing the window is an event like any other, not exit()
+		glutSetOption(GLUT_ACTION_ON_WINDOW_CLOSE, GLUT_ACTION_CONTINUE_EXECUTION);
+		// GLFW reports a held key once, then as repeats the game ignores
+		glutIgnoreKeyRepeat(1);
+		glutReshapeFunc(reshape);
+		glutDisplayFunc(display);
+		glutCloseFunc(closing);
+		glutKeyboardFunc(keyDown);
+		glutKeyboardUpFunc(keyUp);
+		glutSpecialFunc(specialDown);
+		glutSpecialUpFunc(specialUp);
+		glutMouseFunc(mouse);
+		glutMouseWheelFunc(wheel);
+		glutMotionFunc(moved);
+		glutPassiveMotionFunc(moved);
+		return true;
+	}
+
+	void close () {
+		if (window <= 0)
+			return;
+		if (!closed)
+			glutDestroyWindow(window);
+		glutExit();
+		window = 0;
+		Glut = NULL;
+	}
+
+	void pollEvents () { glutMainLoopEvent(); }
+
+	/* freeglut cannot block with a timeout: poll every few milliseconds instead */
+	void waitEvents (double timeout) {
+		struct timespec nap = { 0, 5000000 };
+		events = false;
+		for (double waited = 0; waited < timeout && !events && !closed; waited += 0.005) {
+			glutMainLoopEvent();
+			if (!events)
+				nanosleep(&nap, NULL);
+		}
+	}
+	bool shouldClose () { return closed; }
+
+	// GLUT has no swap control: the driver's default applies
+	bool swapInterval (int /*interval*/) { return false; }
+	void swapBuffers () { glutSwapBuffers(); }
+
+	// freeglut cannot release its context, so frames are replayed on this thread
+	bool makeCurrent (bool /*current*/) { return false; }
+	bool current () { return window > 0 && !closed; }
+
+	void windowSize (int &w, int &h) { w = width; h = height; }
+	void framebufferSize (int &w, int &h) { w = width; h = height; }
+	void cursorPos (double &x, double &y) { x = cursorx; y = cursory; }
+};
+
+Platform *createGlutPlatform ()
+{
+	return new GlutPlatform();
+}
@@ -0,0 +1,99 @@
+#include "renderer.h"
+#include "gltrace.h"
+#include "instrument.h"
+#include "platform.h"
+
+using namespace std;
+
+RenderThread::RenderThread ()
+{
+	recording = &buffers[0];
+	capture = NULL;
+	platform = NULL;
+	pending = NULL;
+	finished = quitting = threaded = false;
+}
+
+void RenderThread::start (Platform *p, bool with_thread)
+{
+	platform = p;
+	threaded = with_thread && platform->makeCurrent(false);
+	if (threaded)
+		thread = std::thread(&RenderThread::run, this);
+}
+
+/* Replay and swap one frame on the thread that owns the context */
+void RenderThread::present (CommandBuffer &frame)
+{
+	replay(frame);
+	double swap = instrumentNow();
+	platform->swapBuffers();
+	glTraceFrame();
+	FrameTiming t = { frame.input_time, swap, instrumentNow() };
+	unique_lock<mutex> hold(lock);
+	timing = t;
+	finished = true;
+}
+
+void RenderThread::run ()
+{
+	platform->makeCurrent(true);
+	unique_lock<mutex> hold(lock);
+	for (;;) {
+		changed.wait(hold, [this] { return pending != NULL || quitting; });
+		if (pending == NULL)
+			break;
+		hold.unlock();
+		present(*pending);
+		hold.lock();
+		pending = NULL;
+		changed.notify_all();
+	}
+	platform->makeCurrent(false);
+}
+
+bool RenderThread::submit (FrameTiming &done)
+{
+	if (capture)
+		captureFrame(capture, *recording);
+	if (!threaded)
+		present(*recording);
+	else {
+		unique_lock<mutex> hold(lock);
+		changed.wait(hold, [this] { return pending == NULL; });
+		pending = recording;
+		changed.notify_all();
+	}
+	// The other buffer is free: either never handed over or already presented
+	recording = recording == &buffers[0] ? &buffers[1] : &buffers[0];
+	recording->reset();
+
+	unique_lock<mutex> hold(lock);
+	if (!finished)
+		return false;
+	done = timing;
+	finished = false;
+	return true;
+}
+
+void RenderThread::finish ()
+{
+	if (!threaded)
+		return;
+	unique_lock<mutex> hold(lock);
+	changed.wait(hold, [this] { return pending == NULL; });
+}
+
+void RenderThread::stop ()
+{
+	if (!threaded)
+		return;
+	{
+		unique_lock<mutex> hold(lock);
+		quitting = true;
+		changed.notify_all();
+	}
+	thread.join();
+	threaded = false;
+	platform->makeCurrent(true);
+}
@@ -0,0 +1,55 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "commands.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct Platform;
+
+/* When a finished frame's input was sampled, its swap started and it was
+   presented, in instrumentNow() seconds */
+struct FrameTiming {
+	double input, swap, present;
+};
+
+/* Owns the GL context after start(). The game records frame N+1 into
+   'recording' while the render thread replays and swaps frame N; at most
+   one frame is in flight. Unthreaded, submit() replays and swaps inline. */
+struct RenderThread {
+	CommandBuffer buffers[2];
+	CommandBuffer *recording;	// the frame being built by the game thread
+	FILE *capture;				// every submitted frame is appended, may be NULL
+
+	RenderThread ();
+
+	/* Hand the context over to the render thread when 'threaded' and the
+	   platform lets contexts move between threads */
+	void start (Platform *platform, bool threaded);
+
+	/* Queue the recorded frame and start a new one. Fills 'done' and returns
+	   true when a frame finished presenting since the last call. */
+	bool submit (FrameTiming &done);
+
+	/* Wait until every submitted frame has been presented */
+	void finish ();
+
+	/* Join the render thread; the context is current on the caller again */
+	void stop ();
+
+private:
+	Platform *platform;
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable changed;
+	CommandBuffer *pending;		// handed over, not yet presented
+	FrameTiming timing;
+	bool finished, quitting, threaded;
+
+	void present (CommandBuffer &frame);
+	void run ();
+};
+
+#endif
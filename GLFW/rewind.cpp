@@ -0,0 +1,151 @@
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+RewindBuffer::RewindBuffer (size_t arena_bytes, size_t capacity)
+	: arena(arena_bytes), records(capacity)
+{
+	clear();
+}
+
+void RewindBuffer::clear ()
+{
+	first = count = head = 0;
+	current.clear();
+	primed = false;
+}
+
+static void putVarint (vector<uint8_t> &out, uint32_t v)
+{
+	while (v >= 0x80) {
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+static uint32_t getVarint (const uint8_t *&p)
+{
+	uint32_t v = 0;
+	for (int shift=0; ; shift+=7) {
+		uint8_t b = *p++;
+		v |= (uint32_t)(b & 0x7f) << shift;
+		if (!(b & 0x80))
+			return v;
+	}
+}
+
+/* XOR of a and b (the shorter one zero-extended) as (zero run, literal run) pairs */
+static void encodeDelta (const vector<uint8_t> &a, const vector<uint8_t> &b, vector<uint8_t> &out)
+{
+	size_t n = max(a.size(), b.size());
+	out.clear();
+	size_t i = 0;
+	while (i < n) {
+		size_t zeros = i;
+		while (zeros < n && (zeros < a.size() ? a[zeros] : 0) == (zeros < b.size() ? b[zeros] : 0))
+			zeros++;
+		size_t literal = zeros;
+		while (literal < n && (literal < a.size() ? a[literal] : 0) != (literal < b.size() ? b[literal] : 0))
+			literal++;
+		putVarint(out, zeros - i);
+		putVarint(out, literal - zeros);
+		for (size_t k=zeros; k<literal; k++)
+			out.push_back((k < a.size() ? a[k] : 0) ^ (k < b.size() ? b[k] : 0));
+		i = literal;
+	}
+}
+
+static void applyDelta (const uint8_t *p, uint32_t length, vector<uint8_t> &state)
+{
+	const uint8_t *end = p + length;
+	size_t i = 0;
+	while (p < end) {
+		i += getVarint(p);
+		uint32_t literal = getVarint(p);
+		if (state.size() < i + literal)
+			state.resize(i + literal, 0);
+		for (uint32_t k=0; k<literal; k++)
+			state[i++] ^= *p++;
+	}
+}
+
+void RewindBuffer::record (const vector<uint8_t> &state, double time)
+{
+	if (!primed) {
+		current = state;
+		primed = true;
+		return;
+	}
+	encodeDelta(current, state, scratch);
+	if (scratch.size() > arena.size()) {
+		// A single delta bigger than the whole budget: history cannot reach
+		// past it, so start again from this state
+		first = count = head = 0;
+		current = state;
+		return;
+	}
+
+	// Wrap to the start if it does not fit before the end of the arena
+	size_t offset = head;
+	if (offset + scratch.size() > arena.size())
+		offset = 0;
+	// Records lie in the arena in time order. After a wrap, everything from
+	// head to the end is older than anything at the front, so it goes first;
+	// then the oldest records whose bytes or slot this one would overwrite
+	bool wrapped = offset < head;
+	while (count > 0) {
+		const Record &oldest = records[first];
+		bool overlaps = oldest.offset < offset + scratch.size() && offset < oldest.offset + oldest.length;
+		bool stranded = wrapped && oldest.offset >= head;
+		if (!overlaps && !stranded && count < records.size())
+			break;
+		first = (first + 1) % records.size();
+		count--;
+	}
+
+	memcpy(&arena[offset], &scratch[0], scratch.size());
+	Record &r = records[(first + count) % records.size()];
+	r.offset = offset;
+	r.length = scratch.size();
+	r.previous = current.size();
+	r.time = time;
+	count++;
+	head = offset + scratch.size();
+	current = state;
+}
+
+bool RewindBuffer::rewind (double time, vector<uint8_t> &state)
+{
+	if (!primed)
+		return false;
+	while (count > 0) {
+		const Record &newest = records[(first + count - 1) % records.size()];
+		if (newest.time <= time)
+			break;
+		applyDelta(&arena[newest.offset], newest.length, current);
+		current.resize(newest.previous);
+		head = newest.offset;
+		count--;
+	}
+	state = current;
+	return true;
+}
+
+double RewindBuffer::span () const
+{
+	if (count == 0)
+		return 0;
+	return records[(first + count - 1) % records.size()].time - records[first].time;
+}
+
+size_t RewindBuffer::bytesUsed () const
+{
+	size_t bytes = current.size();
+	for (size_t i=0; i<count; i++)
+		bytes += records[(first + i) % records.size()].length;
+	return bytes;
+}
@@ -0,0 +1,49 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* Bounded history of serialized game states for rewinding.
+
+   Each tick's state is stored as the XOR of it and the previous state,
+   run-length encoded (most bytes do not change between ticks, so most of
+   the XOR is zero runs). XOR is its own inverse, so the newest state plus
+   the deltas walked backwards reproduce any older state directly; no
+   keyframes are needed. Deltas live in one fixed arena used as a ring:
+   when it fills, the oldest history is dropped. */
+struct RewindBuffer {
+	struct Record {
+		uint32_t offset;		// where the encoded delta starts in the arena
+		uint32_t length;		// encoded bytes
+		uint32_t previous;		// size of the state this delta leads back to
+		double time;			// when the newer state was recorded
+	};
+
+	std::vector<uint8_t> arena;
+	std::vector<Record> records;	// ring of 'capacity' records
+	size_t first, count;			// oldest record and number of live records
+	size_t head;					// next free arena byte
+	std::vector<uint8_t> current;	// newest recorded state
+	std::vector<uint8_t> scratch;
+	bool primed;
+
+	RewindBuffer (size_t arena_bytes, size_t capacity);
+
+	/* Append a state taken at 'time' */
+	void record (const std::vector<uint8_t> &state, double time);
+
+	/* Restore the newest state recorded at or before 'time' into 'state'.
+	   Newer history is discarded. Returns false if nothing is recorded. */
+	bool rewind (double time, std::vector<uint8_t> &state);
+
+	/* Forget all history, e.g. on restart */
+	void clear ();
+
+	/* Seconds of history currently held */
+	double span () const;
+	size_t bytesUsed () const;
+};
+
+#endif
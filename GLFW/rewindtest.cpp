@@ -0,0 +1,84 @@
+/* rewindtest - record and rewind many states through a small RewindBuffer
+   so its arena wraps over and over, and check every rewound state against
+   the state that was recorded at that time.
+
+   usage: rewindtest [--rounds=N]
+
+   Prints "ok" and exits 0, or the first mismatch and exits 1. */
+
+#include "rewind.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+typedef vector<uint8_t> State;
+
+/* A state that drifts a little every tick and sometimes grows or shrinks,
+   like the game's snapshots */
+static void step (State &state)
+{
+	if (rand() % 8 == 0)
+		state.resize(max(16, (int)state.size() + rand() % 65 - 32), 0);
+	for (int n = rand() % 24; n > 0; n--)
+		state[rand() % state.size()] = rand();
+}
+
+static bool check (int round, int arena, int capacity)
+{
+	RewindBuffer buffer(arena, capacity);
+	vector<State> states;
+	vector<double> times;
+	State state(64, 0), out;
+	double time = 0;
+	for (int tick=0; tick<2000; tick++) {
+		step(state);
+		buffer.record(state, time);
+		states.push_back(state);
+		times.push_back(time);
+		time += 1;
+		if (rand() % 50 != 0 || buffer.span() == 0)
+			continue;
+
+		// Somewhere inside the history that is still held
+		double newest = times.back();
+		double target = newest - buffer.span() * (rand() % 100) / 100.0;
+		if (!buffer.rewind(target, out))
+			return false;
+		size_t expected = times.size() - 1;
+		while (times[expected] > target)
+			expected--;
+		if (out != states[expected]) {
+			printf("round %d: arena %d, capacity %d: rewind to t=%.0f at tick %d gave a state that was never recorded\n",
+					round, arena, capacity, target, tick);
+			return false;
+		}
+		// Newer history is gone; carry on from the rewound state
+		states.resize(expected + 1);
+		times.resize(expected + 1);
+		state = out;
+	}
+	return true;
+}
+
+int main (int argc, char **argv)
+{
+	int rounds = 200;
+	for (int a=1; a<argc; a++)
+		if (sscanf(argv[a], "--rounds=%d", &rounds) != 1 || rounds < 1) {
+			fprintf(stderr, "usage: %s [--rounds=N]\n", argv[0]);
+			return 1;
+		}
+	srand(1);
+	for (int round=0; round<rounds; round++) {
+		// Arenas from a few deltas to a few hundred; sometimes the record ring fills first
+		int arena = 64 + rand() % 4096, capacity = 4 + rand() % 256;
+		if (!check(round, arena, capacity))
+			return 1;
+	}
+	printf("ok\n");
+	return 0;
+}
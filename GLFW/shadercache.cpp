@@ -0,0 +1,116 @@
+#include "shadercache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+using namespace std;
+
+static const char CacheMagic[4] = { 'S', 'G', 'L', 'C' };
+static const uint32_t CacheVersion = 1;
+
+struct CacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;
+	uint32_t length;
+};
+
+/* FNV-1a, chained over every string that must match for a binary to be valid */
+static uint64_t hashString (uint64_t h, const char *s)
+{
+	for (; s && *s; s++) {
+		h ^= (unsigned char)*s;
+		h *= 1099511628211ULL;
+	}
+	h ^= 0xff;		// separator so "ab"+"c" differs from "a"+"bc"
+	h *= 1099511628211ULL;
+	return h;
+}
+
+static uint64_t cacheKey (const char *vertex_source, const char *fragment_source)
+{
+	uint64_t h = 14695981039346656037ULL;
+	h = hashString(h, vertex_source);
+	h = hashString(h, fragment_source);
+	h = hashString(h, (const char *) glGetString(GL_VENDOR));
+	h = hashString(h, (const char *) glGetString(GL_RENDERER));
+	h = hashString(h, (const char *) glGetString(GL_VERSION));
+	return h;
+}
+
+bool shaderCacheSupported ()
+{
+	if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary)
+		return false;
+	GLint formats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	return formats > 0;
+}
+
+GLuint shaderCacheLoad (const char *path, const char *vertex_source, const char *fragment_source)
+{
+	if (!shaderCacheSupported())
+		return 0;
+
+	FILE *file = fopen(path, "rb");
+	if (!file)
+		return 0;
+
+	CacheHeader header;
+	vector<char> binary;
+	bool ok = fread(&header, sizeof header, 1, file) == 1
+		&& memcmp(header.magic, CacheMagic, sizeof CacheMagic) == 0
+		&& header.version == CacheVersion
+		&& header.key == cacheKey(vertex_source, fragment_source);
+	if (ok) {
+		binary.resize(header.length);
+		ok = header.length > 0 && fread(&binary[0], 1, header.length, file) == header.length;
+	}
+	fclose(file);
+	if (!ok)
+		return 0;
+
+	GLuint ProgramID = glCreateProgram();
+	glProgramBinary(ProgramID, header.format, &binary[0], header.length);
+
+	// Drivers may still refuse a binary they produced (e.g. after an update)
+	GLint Result = GL_FALSE;
+	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
+	if (Result != GL_TRUE) {
+		glDeleteProgram(ProgramID);
+		return 0;
+	}
+	return ProgramID;
+}
+
+void shaderCacheStore (const char *path, GLuint program, const char *vertex_source, const char *fragment_source)
+{
+	if (!shaderCacheSupported())
+		return;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	CacheHeader header;
+	memcpy(header.magic, CacheMagic, sizeof CacheMagic);
+	header.version = CacheVersion;
+	header.key = cacheKey(vertex_source, fragment_source);
+
+	vector<char> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+	header.format = format;
+	header.length = length;
+
+	FILE *file = fopen(path, "wb");
+	if (!file)
+		return;
+	fwrite(&header, sizeof header, 1, file);
+	fwrite(&binary[0], 1, length, file);
+	fclose(file);
+}
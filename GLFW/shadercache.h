@@ -0,0 +1,17 @@
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <glad/glad.h>
+
+/* True when the context can hand program binaries back to us */
+bool shaderCacheSupported ();
+
+/* Rebuild a program from the binary cached at 'path'. The entry must have
+   been stored for the same sources and the same driver, otherwise (or if
+   the driver rejects it) 0 is returned and the caller compiles as usual. */
+GLuint shaderCacheLoad (const char *path, const char *vertex_source, const char *fragment_source);
+
+/* Save the binary of a program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT */
+void shaderCacheStore (const char *path, GLuint program, const char *vertex_source, const char *fragment_source);
+
+#endif
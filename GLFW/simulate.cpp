@@ -0,0 +1,419 @@
+#include "simulate.h"
+#include "ecs.h"
+#include "jobs.h"
+#include "level.h"
+
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+const char *simulateTarget ()
+{
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__SSE2__)
+	return "sse2";
+#else
+	return "scalar";
+#endif
+}
+
+/* Scalar reference, also used for the tail of the vector loops */
+static void sweepBricksScalar (float *pos, const float *posx, const int32_t *color, const int32_t *vis,
+		int first, int count, const BrickSweep &s, BrickEvents &events)
+{
+	for (int i=first; i<count; i++) {
+		float y = pos[i] -= s.fall;
+		bool band = y < s.top && y > s.bottom;
+		bool red = band && std::fabs(s.red_x - posx[i]) < s.halfwidth;
+		bool green = band && std::fabs(s.green_x - posx[i]) < s.halfwidth;
+		bool caught = !vis[i] && ((red && color[i]==BRICK_RED) || (green && color[i]==BRICK_GREEN));
+		if (caught)
+			events.caught.push_back(i);
+		if ((red || green) && color[i]==BRICK_BLACK)
+			events.hazards.push_back(i);
+		if (!vis[i] && !caught && y <= s.miss)
+			events.misses.push_back(i);
+	}
+}
+
+static inline void pushBits (std::vector<int> &out, unsigned bits, int base)
+{
+	while (bits) {
+		out.push_back(base + __builtin_ctz(bits));
+		bits &= bits - 1;
+	}
+}
+
+void sweepBricks (float *pos, const float *posx, const int32_t *color, const int32_t *vis,
+		int count, const BrickSweep &s, BrickEvents &events)
+{
+	events.clear();
+	int i = 0;
+#if defined(__AVX2__)
+	const __m256 fall = _mm256_set1_ps(s.fall), top = _mm256_set1_ps(s.top);
+	const __m256 bottom = _mm256_set1_ps(s.bottom), miss = _mm256_set1_ps(s.miss);
+	const __m256 red_x = _mm256_set1_ps(s.red_x), green_x = _mm256_set1_ps(s.green_x);
+	const __m256 half = _mm256_set1_ps(s.halfwidth), sign = _mm256_set1_ps(-0.0f);
+	const __m256i red_c = _mm256_set1_epi32(BRICK_RED), green_c = _mm256_set1_epi32(BRICK_GREEN);
+	const __m256i black_c = _mm256_set1_epi32(BRICK_BLACK), zero = _mm256_setzero_si256();
+	for (; i+8<=count; i+=8) {
+		__m256 y = _mm256_sub_ps(_mm256_loadu_ps(pos+i), fall);
+		_mm256_storeu_ps(pos+i, y);
+		__m256 x = _mm256_loadu_ps(posx+i);
+		__m256 band = _mm256_and_ps(_mm256_cmp_ps(y, top, _CMP_LT_OQ), _mm256_cmp_ps(y, bottom, _CMP_GT_OQ));
+		__m256 red = _mm256_and_ps(band, _mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(red_x, x)), half, _CMP_LT_OQ));
+		__m256 green = _mm256_and_ps(band, _mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(green_x, x)), half, _CMP_LT_OQ));
+		__m256i c = _mm256_loadu_si256((const __m256i*)(color+i));
+		__m256 live = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*)(vis+i)), zero));
+		__m256 caught = _mm256_and_ps(live, _mm256_or_ps(
+				_mm256_and_ps(red, _mm256_castsi256_ps(_mm256_cmpeq_epi32(c, red_c))),
+				_mm256_and_ps(green, _mm256_castsi256_ps(_mm256_cmpeq_epi32(c, green_c)))));
+		__m256 hazard = _mm256_and_ps(_mm256_or_ps(red, green), _mm256_castsi256_ps(_mm256_cmpeq_epi32(c, black_c)));
+		__m256 missed = _mm256_andnot_ps(caught, _mm256_and_ps(live, _mm256_cmp_ps(y, miss, _CMP_LE_OQ)));
+		pushBits(events.caught, _mm256_movemask_ps(caught), i);
+		pushBits(events.hazards, _mm256_movemask_ps(hazard), i);
+		pushBits(events.misses, _mm256_movemask_ps(missed), i);
+	}
+#elif defined(__SSE2__)
+	const __m128 fall = _mm_set1_ps(s.fall), top = _mm_set1_ps(s.top);
+	const __m128 bottom = _mm_set1_ps(s.bottom), miss = _mm_set1_ps(s.miss);
+	const __m128 red_x = _mm_set1_ps(s.red_x), green_x = _mm_set1_ps(s.green_x);
+	const __m128 half = _mm_set1_ps(s.halfwidth), sign = _mm_set1_ps(-0.0f);
+	const __m128i red_c = _mm_set1_epi32(BRICK_RED), green_c = _mm_set1_epi32(BRICK_GREEN);
+	const __m128i black_c = _mm_set1_epi32(BRICK_BLACK), zero = _mm_setzero_si128();
+	for (; i+4<=count; i+=4) {
+		__m128 y = _mm_sub_ps(_mm_loadu_ps(pos+i), fall);
+		_mm_storeu_ps(pos+i, y);
+		__m128 x = _mm_loadu_ps(posx+i);
+		__m128 band = _mm_and_ps(_mm_cmplt_ps(y, top), _mm_cmpgt_ps(y, bottom));
+		__m128 red = _mm_and_ps(band, _mm_cmplt_ps(_mm_andnot_ps(sign, _mm_sub_ps(red_x, x)), half));
+		__m128 green = _mm_and_ps(band, _mm_cmplt_ps(_mm_andnot_ps(sign, _mm_sub_ps(green_x, x)), half));
+		__m128i c = _mm_loadu_si128((const __m128i*)(color+i));
+		__m128 live = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(vis+i)), zero));
+		__m128 caught = _mm_and_ps(live, _mm_or_ps(
+				_mm_and_ps(red, _mm_castsi128_ps(_mm_cmpeq_epi32(c, red_c))),
+				_mm_and_ps(green, _mm_castsi128_ps(_mm_cmpeq_epi32(c, green_c)))));
+		__m128 hazard = _mm_and_ps(_mm_or_ps(red, green), _mm_castsi128_ps(_mm_cmpeq_epi32(c, black_c)));
+		__m128 missed = _mm_andnot_ps(caught, _mm_and_ps(live, _mm_cmple_ps(y, miss)));
+		pushBits(events.caught, _mm_movemask_ps(caught), i);
+		pushBits(events.hazards, _mm_movemask_ps(hazard), i);
+		pushBits(events.misses, _mm_movemask_ps(missed), i);
+	}
+#endif
+	sweepBricksScalar(pos, posx, color, vis, i, count, s, events);
+}
+
+static void advanceLasersScalar (const LaserArrays &l, int first, int count, float step,
+		const LevelMirror *mirrors, int mirror_count)
+{
+	for (int i=first; i<count; i++) {
+		float t = l.travel[i] += step;
+		float x = l.x[i] = l.ox[i] + t*l.dx[i];
+		float y = l.y[i] = l.oy[i] + t*l.dy[i];
+		float x1 = l.x1[i] = x + LASER_LENGTH*l.dx[i];
+		float y1 = l.y1[i] = y + LASER_LENGTH*l.dy[i];
+		// the laser segment must cross the mirror's line and the
+		// mirror's ends must lie on either side of the laser
+		float lx = x1-x, ly = y1-y;
+		for (int m=0; m<mirror_count; m++) {
+			const LevelMirror &mirror = mirrors[m];
+			float m0x = mirror.x-mirror.back*mirror.dx, m0y = mirror.y-mirror.back*mirror.dy;
+			float m1x = mirror.x+mirror.front*mirror.dx, m1y = mirror.y+mirror.front*mirror.dy;
+			float side0 = (x-mirror.x)*mirror.dy-(y-mirror.y)*mirror.dx;
+			float side1 = (x1-mirror.x)*mirror.dy-(y1-mirror.y)*mirror.dx;
+			float end0 = (m0x-x)*ly-(m0y-y)*lx;
+			float end1 = (m1x-x)*ly-(m1y-y)*lx;
+			if (side0*side1 < 0 && end0*end1 < 0) {
+				float along = 2*(l.dx[i]*mirror.dx + l.dy[i]*mirror.dy);
+				l.dx[i] = along*mirror.dx - l.dx[i];
+				l.dy[i] = along*mirror.dy - l.dy[i];
+				l.ox[i] = (x+x1)/2;
+				l.oy[i] = (y+y1)/2;
+				l.travel[i] = 0;
+				break;
+			}
+		}
+	}
+}
+
+void advanceLasers (const LaserArrays &l, int count, float step,
+		const LevelMirror *mirrors, int mirror_count)
+{
+	int i = 0;
+#if defined(__AVX2__)
+	const __m256 vstep = _mm256_set1_ps(step), len = _mm256_set1_ps(LASER_LENGTH);
+	const __m256 half = _mm256_set1_ps(0.5f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+	for (; i+8<=count; i+=8) {
+		__m256 t = _mm256_add_ps(_mm256_loadu_ps(l.travel+i), vstep);
+		__m256 dx = _mm256_loadu_ps(l.dx+i), dy = _mm256_loadu_ps(l.dy+i);
+		__m256 ox = _mm256_loadu_ps(l.ox+i), oy = _mm256_loadu_ps(l.oy+i);
+		__m256 x = _mm256_add_ps(ox, _mm256_mul_ps(t, dx));
+		__m256 y = _mm256_add_ps(oy, _mm256_mul_ps(t, dy));
+		__m256 lx = _mm256_mul_ps(len, dx), ly = _mm256_mul_ps(len, dy);
+		__m256 x1 = _mm256_add_ps(x, lx), y1 = _mm256_add_ps(y, ly);
+		_mm256_storeu_ps(l.x+i, x);
+		_mm256_storeu_ps(l.y+i, y);
+		_mm256_storeu_ps(l.x1+i, x1);
+		_mm256_storeu_ps(l.y1+i, y1);
+		// direction of the first mirror hit per lane
+		__m256 hit = zero, mdx = zero, mdy = zero;
+		for (int m=0; m<mirror_count; m++) {
+			const LevelMirror &mirror = mirrors[m];
+			__m256 cx = _mm256_set1_ps(mirror.x), cy = _mm256_set1_ps(mirror.y);
+			__m256 ux = _mm256_set1_ps(mirror.dx), uy = _mm256_set1_ps(mirror.dy);
+			__m256 m0x = _mm256_set1_ps(mirror.x-mirror.back*mirror.dx), m0y = _mm256_set1_ps(mirror.y-mirror.back*mirror.dy);
+			__m256 m1x = _mm256_set1_ps(mirror.x+mirror.front*mirror.dx), m1y = _mm256_set1_ps(mirror.y+mirror.front*mirror.dy);
+			__m256 side0 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(x, cx), uy), _mm256_mul_ps(_mm256_sub_ps(y, cy), ux));
+			__m256 side1 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(x1, cx), uy), _mm256_mul_ps(_mm256_sub_ps(y1, cy), ux));
+			__m256 end0 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(m0x, x), ly), _mm256_mul_ps(_mm256_sub_ps(m0y, y), lx));
+			__m256 end1 = _mm256_sub_ps(_mm256_mul_ps(_mm256_sub_ps(m1x, x), ly), _mm256_mul_ps(_mm256_sub_ps(m1y, y), lx));
+			__m256 cross = _mm256_and_ps(_mm256_cmp_ps(_mm256_mul_ps(side0, side1), zero, _CMP_LT_OQ),
+					_mm256_cmp_ps(_mm256_mul_ps(end0, end1), zero, _CMP_LT_OQ));
+			__m256 first = _mm256_andnot_ps(hit, cross);
+			mdx = _mm256_blendv_ps(mdx, ux, first);
+			mdy = _mm256_blendv_ps(mdy, uy, first);
+			hit = _mm256_or_ps(hit, cross);
+		}
+		if (_mm256_movemask_ps(hit)) {
+			__m256 along = _mm256_mul_ps(two, _mm256_add_ps(_mm256_mul_ps(dx, mdx), _mm256_mul_ps(dy, mdy)));
+			dx = _mm256_blendv_ps(dx, _mm256_sub_ps(_mm256_mul_ps(along, mdx), dx), hit);
+			dy = _mm256_blendv_ps(dy, _mm256_sub_ps(_mm256_mul_ps(along, mdy), dy), hit);
+			ox = _mm256_blendv_ps(ox, _mm256_mul_ps(half, _mm256_add_ps(x, x1)), hit);
+			oy = _mm256_blendv_ps(oy, _mm256_mul_ps(half, _mm256_add_ps(y, y1)), hit);
+			t = _mm256_blendv_ps(t, zero, hit);
+			_mm256_storeu_ps(l.dx+i, dx);
+			_mm256_storeu_ps(l.dy+i, dy);
+			_mm256_storeu_ps(l.ox+i, ox);
+			_mm256_storeu_ps(l.oy+i, oy);
+		}
+		_mm256_storeu_ps(l.travel+i, t);
+	}
+#elif defined(__SSE2__)
+	// SSE2 has no blendv: select with and/andnot/or
+	#define SELECT(a, b, mask) _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b))
+	const __m128 vstep = _mm_set1_ps(step), len = _mm_set1_ps(LASER_LENGTH);
+	const __m128 half = _mm_set1_ps(0.5f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+	for (; i+4<=count; i+=4) {
+		__m128 t = _mm_add_ps(_mm_loadu_ps(l.travel+i), vstep);
+		__m128 dx = _mm_loadu_ps(l.dx+i), dy = _mm_loadu_ps(l.dy+i);
+		__m128 ox = _mm_loadu_ps(l.ox+i), oy = _mm_loadu_ps(l.oy+i);
+		__m128 x = _mm_add_ps(ox, _mm_mul_ps(t, dx));
+		__m128 y = _mm_add_ps(oy, _mm_mul_ps(t, dy));
+		__m128 lx = _mm_mul_ps(len, dx), ly = _mm_mul_ps(len, dy);
+		__m128 x1 = _mm_add_ps(x, lx), y1 = _mm_add_ps(y, ly);
+		_mm_storeu_ps(l.x+i, x);
+		_mm_storeu_ps(l.y+i, y);
+		_mm_storeu_ps(l.x1+i, x1);
+		_mm_storeu_ps(l.y1+i, y1);
+		__m128 hit = zero, mdx = zero, mdy = zero;
+		for (int m=0; m<mirror_count; m++) {
+			const LevelMirror &mirror = mirrors[m];
+			__m128 cx = _mm_set1_ps(mirror.x), cy = _mm_set1_ps(mirror.y);
+			__m128 ux = _mm_set1_ps(mirror.dx), uy = _mm_set1_ps(mirror.dy);
+			__m128 m0x = _mm_set1_ps(mirror.x-mirror.back*mirror.dx), m0y = _mm_set1_ps(mirror.y-mirror.back*mirror.dy);
+			__m128 m1x = _mm_set1_ps(mirror.x+mirror.front*mirror.dx), m1y = _mm_set1_ps(mirror.y+mirror.front*mirror.dy);
+			__m128 side0 = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x, cx), uy), _mm_mul_ps(_mm_sub_ps(y, cy), ux));
+			__m128 side1 = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(x1, cx), uy), _mm_mul_ps(_mm_sub_ps(y1, cy), ux));
+			__m128 end0 = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(m0x, x), ly), _mm_mul_ps(_mm_sub_ps(m0y, y), lx));
+			__m128 end1 = _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(m1x, x), ly), _mm_mul_ps(_mm_sub_ps(m1y, y), lx));
+			__m128 cross = _mm_and_ps(_mm_cmplt_ps(_mm_mul_ps(side0, side1), zero),
+					_mm_cmplt_ps(_mm_mul_ps(end0, end1), zero));
+			__m128 first = _mm_andnot_ps(hit, cross);
+			mdx = SELECT(mdx, ux, first);
+			mdy = SELECT(mdy, uy, first);
+			hit = _mm_or_ps(hit, cross);
+		}
+		if (_mm_movemask_ps(hit)) {
+			__m128 along = _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(dx, mdx), _mm_mul_ps(dy, mdy)));
+			dx = SELECT(dx, _mm_sub_ps(_mm_mul_ps(along, mdx), dx), hit);
+			dy = SELECT(dy, _mm_sub_ps(_mm_mul_ps(along, mdy), dy), hit);
+			ox = SELECT(ox, _mm_mul_ps(half, _mm_add_ps(x, x1)), hit);
+			oy = SELECT(oy, _mm_mul_ps(half, _mm_add_ps(y, y1)), hit);
+			t = SELECT(t, zero, hit);
+			_mm_storeu_ps(l.dx+i, dx);
+			_mm_storeu_ps(l.dy+i, dy);
+			_mm_storeu_ps(l.ox+i, ox);
+			_mm_storeu_ps(l.oy+i, oy);
+		}
+		_mm_storeu_ps(l.travel+i, t);
+	}
+	#undef SELECT
+#endif
+	advanceLasersScalar(l, i, count, step, mirrors, mirror_count);
+}
+
+void collideLasers (const float *pos, const float *posx, int bricks,
+		const float *laserx, const float *lasery, int lasers, std::vector<LaserHit> &hits)
+{
+	hits.clear();
+	for (int z=0; z<bricks; z++) {
+		float bx = posx[z], by = BRICK_Y0 + pos[z];
+		int y = 0;
+#if defined(__AVX2__)
+		const __m256 vx = _mm256_set1_ps(bx), vy = _mm256_set1_ps(by);
+		const __m256 reach = _mm256_set1_ps(0.2f), sign = _mm256_set1_ps(-0.0f);
+		for (; y+8<=lasers; y+=8) {
+			__m256 near = _mm256_and_ps(
+					_mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(vy, _mm256_loadu_ps(lasery+y))), reach, _CMP_LT_OQ),
+					_mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(vx, _mm256_loadu_ps(laserx+y))), reach, _CMP_LT_OQ));
+			for (unsigned bits=_mm256_movemask_ps(near); bits; bits&=bits-1) {
+				LaserHit hit = { z, y + __builtin_ctz(bits) };
+				hits.push_back(hit);
+			}
+		}
+#elif defined(__SSE2__)
+		const __m128 vx = _mm_set1_ps(bx), vy = _mm_set1_ps(by);
+		const __m128 reach = _mm_set1_ps(0.2f), sign = _mm_set1_ps(-0.0f);
+		for (; y+4<=lasers; y+=4) {
+			__m128 near = _mm_and_ps(
+					_mm_cmplt_ps(_mm_andnot_ps(sign, _mm_sub_ps(vy, _mm_loadu_ps(lasery+y))), reach),
+					_mm_cmplt_ps(_mm_andnot_ps(sign, _mm_sub_ps(vx, _mm_loadu_ps(laserx+y))), reach));
+			for (unsigned bits=_mm_movemask_ps(near); bits; bits&=bits-1) {
+				LaserHit hit = { z, y + __builtin_ctz(bits) };
+				hits.push_back(hit);
+			}
+		}
+#endif
+		for (; y<lasers; y++)
+			if (std::fabs(by - lasery[y]) < 0.2f && std::fabs(bx - laserx[y]) < 0.2f) {
+				LaserHit hit = { z, y };
+				hits.push_back(hit);
+			}
+	}
+}
+
+/* Chunk sizes: enough work per job to pay for queueing it */
+static const int BRICK_GRAIN = 2048, LASER_GRAIN = 512, COLLIDE_GRAIN = 256;
+
+/* Per-chunk results, kept between calls so steady-state frames do not allocate.
+   The parallel kernels are called from one thread at a time. */
+static std::vector<BrickEvents> chunk_events;
+static std::vector< std::vector<LaserHit> > chunk_hits;
+
+template <typename T>
+static void append (std::vector<T> &out, const std::vector<T> &part, int base)
+{
+	for (size_t i=0; i<part.size(); i++)
+		out.push_back(part[i] + base);
+}
+
+static inline LaserHit operator+ (LaserHit hit, int base)
+{
+	hit.brick += base;
+	return hit;
+}
+
+void sweepBricks (JobSystem &jobs, float *pos, const float *posx, const int32_t *color, const int32_t *vis,
+		int count, const BrickSweep &s, BrickEvents &events)
+{
+	// Both paths replace 'events', whatever the thread and brick counts
+	events.clear();
+	int chunks = (count + BRICK_GRAIN - 1) / BRICK_GRAIN;
+	if (chunks <= 1 || jobs.threads() <= 1) {
+		sweepBricks(pos, posx, color, vis, count, s, events);
+		return;
+	}
+	if ((int)chunk_events.size() < chunks)
+		chunk_events.resize(chunks);
+	jobs.parallelFor(0, count, BRICK_GRAIN, [&](int begin, int end) {
+		sweepBricks(pos+begin, posx+begin, color+begin, vis+begin, end-begin, s, chunk_events[begin/BRICK_GRAIN]);
+	});
+	// Chunk indices are local; concatenating in chunk order keeps them ascending
+	for (int c=0; c<chunks; c++) {
+		append(events.caught, chunk_events[c].caught, c*BRICK_GRAIN);
+		append(events.hazards, chunk_events[c].hazards, c*BRICK_GRAIN);
+		append(events.misses, chunk_events[c].misses, c*BRICK_GRAIN);
+		chunk_events[c].clear();
+	}
+}
+
+void advanceLasers (JobSystem &jobs, const LaserArrays &l, int count, float step,
+		const LevelMirror *mirrors, int mirror_count)
+{
+	// Every laser moves on its own
+	jobs.parallelFor(0, count, LASER_GRAIN, [&](int begin, int end) {
+		LaserArrays part = { l.travel+begin, l.ox+begin, l.oy+begin, l.dx+begin, l.dy+begin,
+			l.x+begin, l.y+begin, l.x1+begin, l.y1+begin };
+		advanceLasers(part, end-begin, step, mirrors, mirror_count);
+	});
+}
+
+void collideLasers (JobSystem &jobs, const float *pos, const float *posx, int bricks,
+		const float *laserx, const float *lasery, int lasers, std::vector<LaserHit> &hits)
+{
+	int chunks = (bricks + COLLIDE_GRAIN - 1) / COLLIDE_GRAIN;
+	if (chunks <= 1 || jobs.threads() <= 1) {
+		collideLasers(pos, posx, bricks, laserx, lasery, lasers, hits);
+		return;
+	}
+	if ((int)chunk_hits.size() < chunks)
+		chunk_hits.resize(chunks);
+	jobs.parallelFor(0, bricks, COLLIDE_GRAIN, [&](int begin, int end) {
+		collideLasers(pos+begin, posx+begin, end-begin, laserx, lasery, lasers, chunk_hits[begin/COLLIDE_GRAIN]);
+	});
+	hits.clear();
+	for (int c=0; c<chunks; c++)
+		append(hits, chunk_hits[c], c*COLLIDE_GRAIN);
+}
+
+void sweepBricks (JobSystem &jobs, Archetype &bricks, const BrickSweep &s, BrickEvents &events)
+{
+	int chunks = bricks.chunkCount();
+	if ((int)chunk_events.size() < chunks)
+		chunk_events.resize(chunks);
+	jobs.parallelFor(0, chunks, 1, [&](int begin, int end) {
+		for (int c=begin; c<end; c++)
+			sweepBricks(bricks.floats(c, FIELD_Y), bricks.floats(c, FIELD_X), bricks.ints(c, FIELD_COLOR),
+					bricks.ints(c, FIELD_GONE), bricks.rows(c), s, chunk_events[c]);
+	});
+	events.clear();
+	for (int c=0; c<chunks; c++) {
+		append(events.caught, chunk_events[c].caught, c*bricks.capacity);
+		append(events.hazards, chunk_events[c].hazards, c*bricks.capacity);
+		append(events.misses, chunk_events[c].misses, c*bricks.capacity);
+		chunk_events[c].clear();
+	}
+}
+
+void advanceLasers (JobSystem &jobs, Archetype &lasers, float step,
+		const LevelMirror *mirrors, int mirror_count)
+{
+	jobs.parallelFor(0, lasers.chunkCount(), 1, [&](int begin, int end) {
+		for (int c=begin; c<end; c++) {
+			LaserArrays part = { lasers.floats(c, FIELD_AGE), lasers.floats(c, FIELD_X), lasers.floats(c, FIELD_Y),
+				lasers.floats(c, FIELD_DX), lasers.floats(c, FIELD_DY), lasers.floats(c, FIELD_X0),
+				lasers.floats(c, FIELD_Y0), lasers.floats(c, FIELD_X1), lasers.floats(c, FIELD_Y1) };
+			advanceLasers(part, lasers.rows(c), step, mirrors, mirror_count);
+		}
+	});
+}
+
+/* Laser heads gathered in index order, so every brick chunk tests all lasers in one call */
+static std::vector<float> head_x, head_y;
+
+void collideLasers (JobSystem &jobs, Archetype &bricks, Archetype &lasers, std::vector<LaserHit> &hits)
+{
+	head_x.clear();
+	head_y.clear();
+	for (int c=0; c<lasers.chunkCount(); c++) {
+		head_x.insert(head_x.end(), lasers.floats(c, FIELD_X0), lasers.floats(c, FIELD_X0) + lasers.rows(c));
+		head_y.insert(head_y.end(), lasers.floats(c, FIELD_Y0), lasers.floats(c, FIELD_Y0) + lasers.rows(c));
+	}
+	int chunks = bricks.chunkCount();
+	if ((int)chunk_hits.size() < chunks)
+		chunk_hits.resize(chunks);
+	const float *x = head_x.data(), *y = head_y.data();
+	jobs.parallelFor(0, chunks, 1, [&](int begin, int end) {
+		for (int c=begin; c<end; c++)
+			collideLasers(bricks.floats(c, FIELD_Y), bricks.floats(c, FIELD_X), bricks.rows(c),
+					x, y, lasers.count, chunk_hits[c]);
+	});
+	hits.clear();
+	for (int c=0; c<chunks; c++)
+		append(hits, chunk_hits[c], c*bricks.capacity);
+}
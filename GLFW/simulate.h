@@ -0,0 +1,86 @@
+#ifndef SIMULATE_H
+#define SIMULATE_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Batched simulation kernels over the game's structure-of-arrays state.
+   They only read and write plain arrays, so they build without GL.
+   Vectorized with AVX2 or SSE2 when the compiler targets them (e.g.
+   make SIMD=-mavx2); other targets use the scalar loop. */
+
+/* One brick sweep: everything comes from the level and the baskets */
+struct BrickSweep {
+	float fall;				// y step applied this sweep, 0 when no step is due
+	float red_x, green_x;	// basket centres
+	float halfwidth, top, bottom, miss;	// catch zone and miss line
+};
+
+/* Indices of bricks that changed state in a sweep, in ascending order */
+struct BrickEvents {
+	std::vector<int> caught;	// visible brick in the basket of its own color
+	std::vector<int> hazards;	// black brick inside either basket
+	std::vector<int> misses;	// visible brick fell past the miss line
+
+	void clear () { caught.clear(); hazards.clear(); misses.clear(); }
+};
+
+/* Advance pos[0..count) by -s.fall and classify every brick in one pass.
+   color holds BrickColor values, vis is nonzero for bricks already gone.
+   'events' is replaced with this sweep's events. */
+void sweepBricks (float *pos, const float *posx, const int32_t *color, const int32_t *vis,
+		int count, const BrickSweep &s, BrickEvents &events);
+
+struct LevelMirror;
+
+/* Lasers in flight. Each laser is a segment of LASER_LENGTH starting
+   'travel' along the unit direction (dx,dy) from its origin (ox,oy);
+   (x,y)-(x1,y1) receive the segment for drawing and brick tests. */
+const float LASER_LENGTH = 0.4f;
+
+struct LaserArrays {
+	float *travel, *ox, *oy, *dx, *dy;
+	float *x, *y, *x1, *y1;
+};
+
+/* Move lasers [0,count) 'step' along their direction and bounce each off
+   the first mirror its segment crosses: the origin moves to the hit,
+   travel restarts and the direction is mirrored about the surface. */
+void advanceLasers (const LaserArrays &l, int count, float step,
+		const LevelMirror *mirrors, int mirror_count);
+
+/* World y of a brick whose pos is 0: brick geometry sits at the top of the field */
+const float BRICK_Y0 = 3.5f;
+
+struct LaserHit { int brick, laser; };
+
+/* Every (brick, laser) pair with the laser head within 0.2 of the brick,
+   in brick-major order. Bricks already gone still stop lasers. */
+void collideLasers (const float *pos, const float *posx, int bricks,
+		const float *laserx, const float *lasery, int lasers, std::vector<LaserHit> &hits);
+
+/* The same kernels split into chunks and run on 'jobs'. Results match the
+   single-threaded calls exactly, including the order of events and hits. */
+struct JobSystem;
+void sweepBricks (JobSystem &jobs, float *pos, const float *posx, const int32_t *color, const int32_t *vis,
+		int count, const BrickSweep &s, BrickEvents &events);
+void advanceLasers (JobSystem &jobs, const LaserArrays &l, int count, float step,
+		const LevelMirror *mirrors, int mirror_count);
+void collideLasers (JobSystem &jobs, const float *pos, const float *posx, int bricks,
+		const float *laserx, const float *lasery, int lasers, std::vector<LaserHit> &hits);
+
+/* The same kernels as systems over archetype storage (see ecs.h), one
+   job per chunk. Bricks need TRANSFORM, COLOR and LIFETIME (y is the fall
+   from the spawn line, gone is vis); lasers need TRANSFORM (origin),
+   VELOCITY, COLLIDER (the segment) and LIFETIME (age is travel). Events
+   and hits carry entity indices, in the same order as above. */
+struct Archetype;
+void sweepBricks (JobSystem &jobs, Archetype &bricks, const BrickSweep &s, BrickEvents &events);
+void advanceLasers (JobSystem &jobs, Archetype &lasers, float step,
+		const LevelMirror *mirrors, int mirror_count);
+void collideLasers (JobSystem &jobs, Archetype &bricks, Archetype &lasers, std::vector<LaserHit> &hits);
+
+/* Name of the instruction set the kernels were built for */
+const char *simulateTarget ();
+
+#endif
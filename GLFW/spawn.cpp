@@ -0,0 +1,68 @@
+#include "spawn.h"
+#include "level.h"
+
+static inline uint32_t mulhilo (uint32_t a, uint32_t b, uint32_t &hi)
+{
+	uint64_t product = (uint64_t)a * b;
+	hi = product >> 32;
+	return (uint32_t)product;
+}
+
+void philox4x32 (const uint32_t counter[4], const uint32_t key[2], uint32_t out[4])
+{
+	uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for (int round=0; round<10; round++) {
+		uint32_t hi0, hi1;
+		uint32_t lo0 = mulhilo(0xD2511F53, c0, hi0);
+		uint32_t lo1 = mulhilo(0xCD9E8D57, c2, hi1);
+		c0 = hi1 ^ c1 ^ k0;
+		c1 = lo1;
+		c2 = hi0 ^ c3 ^ k1;
+		c3 = lo0;
+		k0 += 0x9E3779B9;
+		k1 += 0xBB67AE85;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+/* [0, range) from 32 random bits, by multiply and shift rather than modulo */
+static inline int32_t below (uint32_t bits, uint32_t range)
+{
+	return (int32_t)(((uint64_t)bits * range) >> 32);
+}
+
+BrickSpawner::BrickSpawner (uint64_t s)
+{
+	reset(s);
+}
+
+void BrickSpawner::reset (uint64_t s)
+{
+	seed = s;
+	game = 0;
+	spawned = 0;
+}
+
+void BrickSpawner::restart ()
+{
+	game++;
+	spawned = 0;
+}
+
+BrickSpawn BrickSpawner::at (const LevelSpawn &level, uint64_t n) const
+{
+	const uint32_t counter[4] = { (uint32_t)n, (uint32_t)(n >> 32), game, 0 };
+	const uint32_t key[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+	uint32_t bits[4];
+	philox4x32(counter, key, bits);
+
+	BrickSpawn spawn;
+	spawn.x = level.xmin + below(bits[0], level.xcount);
+	const int32_t *weights = spawn.x <= level.split ? level.left : level.right;
+	int32_t pick = below(bits[1], weights[0] + weights[1] + weights[2]);
+	spawn.color = BRICK_BLACK;
+	while (pick >= weights[spawn.color])
+		pick -= weights[spawn.color++];
+	return spawn;
+}
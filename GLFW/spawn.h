@@ -0,0 +1,43 @@
+#ifndef SPAWN_H
+#define SPAWN_H
+
+#include <stdint.h>
+
+struct LevelSpawn;
+
+/* Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as
+   1, 2, 3"): a counter-based generator. Each output block is a pure
+   function of a 128-bit counter and a 64-bit key, so any position in a
+   stream costs the same to reach, from any thread, with no state. */
+void philox4x32 (const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]);
+
+struct BrickSpawn {
+	int32_t x;			// column, as the level's xmin + [0, xcount)
+	int32_t color;		// BrickColor
+};
+
+/* Brick spawns on demand from a seeded stream. Brick n of game g is
+   drawn from counter (n, g) under the seed, so a whole game is fixed by
+   (seed, game), nothing is rolled ahead of time and there is no limit on
+   how many bricks a game has. */
+struct BrickSpawner {
+	uint64_t seed;
+	uint32_t game;		// bumped by restart(), so every game gets its own stream
+	uint64_t spawned;	// bricks handed out in this game
+
+	BrickSpawner (uint64_t seed = 1);
+
+	/* Start over with a new seed, at game 0 */
+	void reset (uint64_t seed);
+	/* Next game under the same seed */
+	void restart ();
+
+	/* Brick 'n' of the current game; does not move the stream */
+	BrickSpawn at (const LevelSpawn &level, uint64_t n) const;
+	/* The next brick */
+	BrickSpawn next (const LevelSpawn &level) { return at(level, spawned++); }
+	/* Jump to brick 'n', ahead or back, e.g. after a rewind */
+	void seek (uint64_t n) { spawned = n; }
+};
+
+#endif
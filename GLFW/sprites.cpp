@@ -0,0 +1,274 @@
+#include "sprites.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+static const float PIXELS_PER_UNIT = 200;
+static const int SUPERSAMPLE = 4;
+static const int ATLAS_SIZE = 512;
+
+/* One filled shape of a sprite, in world units around the sprite's anchor */
+struct Shape {
+	enum { STROKE, DISC, TRIANGLE } kind;
+	float a[6];			// stroke: x,y,angle,length,width; disc: x,y,r; triangle: 3 points
+	uint8_t rgba[4];
+	float c, s;			// stroke direction, filled in by prepare()
+	float x0, y0, x1, y1;	// bounds, filled in by prepare()
+};
+
+struct SpriteArt {
+	vector<Shape> shapes;
+
+	// The HUD's segments: a 0.2 x 0.05 bar from (x,y) turned by 'angle' degrees
+	void bar (float x, float y, float angle, const uint8_t *c) {
+		Shape s = { Shape::STROKE, { x, y, angle, 0.2f, 0.05f }, { c[0], c[1], c[2], c[3] }, 0, 0, 0, 0, 0, 0 };
+		shapes.push_back(s);
+	}
+	void rect (float x0, float y0, float x1, float y1, const uint8_t *c) {
+		Shape s = { Shape::STROKE, { x0, y0, 0, x1-x0, y1-y0 }, { c[0], c[1], c[2], c[3] }, 0, 0, 0, 0, 0, 0 };
+		shapes.push_back(s);
+	}
+	void disc (float x, float y, float r, const uint8_t *c) {
+		Shape s = { Shape::DISC, { x, y, r }, { c[0], c[1], c[2], c[3] }, 0, 0, 0, 0, 0, 0 };
+		shapes.push_back(s);
+	}
+	void triangle (float x0, float y0, float x1, float y1, float x2, float y2, const uint8_t *c) {
+		Shape s = { Shape::TRIANGLE, { x0, y0, x1, y1, x2, y2 }, { c[0], c[1], c[2], c[3] }, 0, 0, 0, 0, 0, 0 };
+		shapes.push_back(s);
+	}
+};
+
+static bool inside (const Shape &s, float x, float y)
+{
+	switch (s.kind) {
+	case Shape::STROKE: {
+		float dx = x - s.a[0], dy = y - s.a[1];
+		float along = dx*s.c + dy*s.s, across = -dx*s.s + dy*s.c;
+		return along >= 0 && along <= s.a[3] && across >= 0 && across <= s.a[4];
+	}
+	case Shape::DISC:
+		return (x-s.a[0])*(x-s.a[0]) + (y-s.a[1])*(y-s.a[1]) <= s.a[2]*s.a[2];
+	case Shape::TRIANGLE: {
+		float d0 = (s.a[2]-s.a[0])*(y-s.a[1]) - (s.a[3]-s.a[1])*(x-s.a[0]);
+		float d1 = (s.a[4]-s.a[2])*(y-s.a[3]) - (s.a[5]-s.a[3])*(x-s.a[2]);
+		float d2 = (s.a[0]-s.a[4])*(y-s.a[5]) - (s.a[1]-s.a[5])*(x-s.a[4]);
+		return (d0 >= 0 && d1 >= 0 && d2 >= 0) || (d0 <= 0 && d1 <= 0 && d2 <= 0);
+	}
+	}
+	return false;
+}
+
+/* Precompute the stroke direction and the bounds of a shape */
+static void prepare (Shape &s)
+{
+	float xs[4], ys[4];
+	int n = 0;
+	if (s.kind == Shape::STROKE) {
+		float angle = s.a[2]*M_PI/180;
+		s.c = cos(angle);
+		s.s = sin(angle);
+		float corners[4][2] = { {0,0}, {s.a[3],0}, {s.a[3],s.a[4]}, {0,s.a[4]} };
+		for (n=0; n<4; n++) {
+			xs[n] = s.a[0] + corners[n][0]*s.c - corners[n][1]*s.s;
+			ys[n] = s.a[1] + corners[n][0]*s.s + corners[n][1]*s.c;
+		}
+	}
+	else if (s.kind == Shape::DISC) {
+		xs[0] = s.a[0]-s.a[2]; ys[0] = s.a[1]-s.a[2];
+		xs[1] = s.a[0]+s.a[2]; ys[1] = s.a[1]+s.a[2];
+		n = 2;
+	}
+	else {
+		for (n=0; n<3; n++) {
+			xs[n] = s.a[2*n];
+			ys[n] = s.a[2*n+1];
+		}
+	}
+	s.x0 = s.x1 = xs[0];
+	s.y0 = s.y1 = ys[0];
+	for (int i=1; i<n; i++) {
+		s.x0 = min(s.x0, xs[i]); s.y0 = min(s.y0, ys[i]);
+		s.x1 = max(s.x1, xs[i]); s.y1 = max(s.y1, ys[i]);
+	}
+}
+
+/* Index of the last shape covering (x,y), -1 for none */
+static int topmost (const SpriteArt &art, float x, float y)
+{
+	for (int s=(int)art.shapes.size()-1; s>=0; s--) {
+		const Shape &shape = art.shapes[s];
+		if (x >= shape.x0 && x <= shape.x1 && y >= shape.y0 && y <= shape.y1 && inside(shape, x, y))
+			return s;
+	}
+	return -1;
+}
+
+static const uint8_t BLUE[4] = { 0, 0, 255, 255 };
+static const uint8_t WHITE[4] = { 255, 255, 255, 255 };
+static const uint8_t BLACK[4] = { 0, 0, 0, 255 };
+static const uint8_t GREEN[4] = { 128, 255, 128, 255 };
+
+/* Segments lit per digit: upper left, lower left, bottom, lower right,
+   upper right, top, middle (the order of the old segment[] meshes) */
+static const uint8_t DIGIT_SEGMENTS[10] = {
+	0x3f, 0x18, 0x76, 0x7c, 0x59, 0x6d, 0x6f, 0x38, 0x7f, 0x79
+};
+
+static void digitArt (SpriteArt &art, int digit)
+{
+	static const float seg[7][3] = {
+		{ 0, 0.2, 90 }, { 0, 0.01, 90 }, { -0.01, 0, 0 }, { 0.23, 0.01, 90 },
+		{ 0.23, 0.2, 90 }, { 0, 0.35, 0 }, { -0.01, 0.17, 0 }
+	};
+	for (int i=0; i<7; i++)
+		if (DIGIT_SEGMENTS[digit] & (1<<i))
+			art.bar(seg[i][0], seg[i][1], seg[i][2], BLUE);
+}
+
+static void scoreArt (SpriteArt &art)
+{
+	// S C O R E, letter c anchored 0.4*c to the right
+	static const uint8_t letters[5] = { 0x6d, 0x27, 0x3f, 0x7b, 0x67 };
+	static const float seg[7][3] = {
+		{ 0, 0.2, 90 }, { 0, 0.01, 90 }, { -0.01, 0, 0 }, { 0.2, 0.01, 90 },
+		{ 0.2, 0.2, 90 }, { 0, 0.35, 0 }, { 0, 0.17, 0 }
+	};
+	for (int c=0; c<5; c++)
+		for (int i=0; i<7; i++)
+			if (letters[c] & (1<<i))
+				art.bar(c*0.4f + seg[i][0], seg[i][1], seg[i][2], BLUE);
+}
+
+static void levelArt (SpriteArt &art)
+{
+	// L E V E L; the V is two slanted bars
+	for (int c=0; c<5; c++) {
+		float x = c*0.4f;
+		if (c == 2) {
+			art.bar(x, 0.2, 120, BLUE);
+			art.bar(x+0.1f, 0.01, 120, BLUE);
+			art.bar(x+0.16f, 0.01, 70, BLUE);
+			art.bar(x+0.22f, 0.2, 70, BLUE);
+			continue;
+		}
+		art.bar(x, 0.2, 90, BLUE);
+		art.bar(x, 0.01, 90, BLUE);
+		art.bar(x-0.01f, 0, 0, BLUE);
+		if (c == 1 || c == 3) {
+			art.bar(x-0.01f, 0.35, 0, BLUE);
+			art.bar(x-0.01f, 0.17, 0, BLUE);
+		}
+	}
+}
+
+static SpriteArt spriteArt (int id)
+{
+	SpriteArt art;
+	if (id < SPRITE_DIGIT0 + 10)
+		digitArt(art, id - SPRITE_DIGIT0);
+	else if (id == SPRITE_SCORE)
+		scoreArt(art);
+	else if (id == SPRITE_LEVEL)
+		levelArt(art);
+	else if (id == SPRITE_PAUSE || id == SPRITE_PLAY) {
+		// anchored at the disc's center; later shapes paint over earlier ones
+		art.disc(0, 0, 0.25, BLACK);
+		if (id == SPRITE_PAUSE) {
+			art.bar(-0.05f, -0.1f, 90, WHITE);
+			art.bar(0.1f, -0.1f, 90, WHITE);
+		}
+		else
+			art.triangle(0.12f, 0, -0.08f, 0.1f, -0.08f, -0.1f, WHITE);
+	}
+	else if (id == SPRITE_RESTART)
+		art.rect(0, 0, 2, 0.7, GREEN);
+	else if (id == SPRITE_GAMEOVER)
+		art.triangle(0, 0, -0.3f, 0.2f, -0.3f, -0.2f, WHITE);
+	else if (id == SPRITE_BRICK)
+		art.rect(0, 3.4, 0.2, 3.7, WHITE);
+	return art;
+}
+
+void buildAtlas (SpriteAtlas &atlas)
+{
+	atlas.width = atlas.height = ATLAS_SIZE;
+	atlas.pixels.assign(ATLAS_SIZE*ATLAS_SIZE*4, 0);
+
+	// Shelf packing in id order, one empty pixel between sprites against bleeding
+	int shelf_x = 1, shelf_y = 1, shelf_h = 0;
+	for (int id=0; id<SPRITE_COUNT; id++) {
+		SpriteArt art = spriteArt(id);
+		float x0 = 1e9, y0 = 1e9, x1 = -1e9, y1 = -1e9;
+		for (size_t i=0; i<art.shapes.size(); i++) {
+			Shape &shape = art.shapes[i];
+			prepare(shape);
+			x0 = min(x0, shape.x0); y0 = min(y0, shape.y0);
+			x1 = max(x1, shape.x1); y1 = max(y1, shape.y1);
+		}
+		int w = (int)ceil((x1-x0)*PIXELS_PER_UNIT), h = (int)ceil((y1-y0)*PIXELS_PER_UNIT);
+		if (shelf_x + w + 1 > ATLAS_SIZE) {
+			shelf_x = 1;
+			shelf_y += shelf_h + 1;
+			shelf_h = 0;
+		}
+		int px = shelf_x, py = shelf_y;
+		shelf_x += w + 1;
+		shelf_h = max(shelf_h, h);
+		if (py + h > ATLAS_SIZE)
+			h = max(0, ATLAS_SIZE - py);	// out of room: the sprite comes out clipped
+
+		// Topmost shape at every pixel corner; pixels whose corners agree are
+		// filled directly, the rest get the coverage-weighted color of subsamples
+		vector<int> corner((w+1)*(h+1));
+		for (int y=0; y<=h; y++)
+			for (int x=0; x<=w; x++)
+				corner[y*(w+1)+x] = topmost(art, x0 + x/PIXELS_PER_UNIT, y0 + y/PIXELS_PER_UNIT);
+		for (int y=0; y<h; y++)
+			for (int x=0; x<w; x++) {
+				uint8_t *p = &atlas.pixels[((py+y)*ATLAS_SIZE + px+x)*4];
+				int c = corner[y*(w+1)+x];
+				if (c == corner[y*(w+1)+x+1] && c == corner[(y+1)*(w+1)+x] && c == corner[(y+1)*(w+1)+x+1]) {
+					if (c >= 0)
+						memcpy(p, art.shapes[c].rgba, 4);
+					continue;
+				}
+				float sum[4] = { 0, 0, 0, 0 };
+				for (int sy=0; sy<SUPERSAMPLE; sy++)
+					for (int sx=0; sx<SUPERSAMPLE; sx++) {
+						int s = topmost(art, x0 + (x + (sx+0.5f)/SUPERSAMPLE) / PIXELS_PER_UNIT,
+								y0 + (y + (sy+0.5f)/SUPERSAMPLE) / PIXELS_PER_UNIT);
+						if (s >= 0)
+							for (int k=0; k<4; k++)
+								sum[k] += art.shapes[s].rgba[k];
+					}
+				float alpha = sum[3] / (SUPERSAMPLE*SUPERSAMPLE);
+				for (int k=0; k<3; k++)
+					p[k] = alpha > 0 ? (uint8_t)(sum[k] / sum[3] * 255 + 0.5f) : 0;
+				p[3] = (uint8_t)(alpha + 0.5f);
+			}
+
+		Sprite &sprite = atlas.sprites[id];
+		sprite.x0 = x0; sprite.y0 = y0;
+		sprite.x1 = x0 + w/PIXELS_PER_UNIT; sprite.y1 = y0 + h/PIXELS_PER_UNIT;
+		sprite.u0 = px/(float)ATLAS_SIZE; sprite.v0 = py/(float)ATLAS_SIZE;
+		sprite.u1 = (px+w)/(float)ATLAS_SIZE; sprite.v1 = (py+h)/(float)ATLAS_SIZE;
+	}
+}
+
+void SpriteBatch::add (const SpriteAtlas &atlas, SpriteId id, float x, float y, float z,
+		float r, float g, float b, float a)
+{
+	const Sprite &s = atlas.sprites[id];
+	SpriteVertex corners[4] = {
+		{ x+s.x0, y+s.y0, z, s.u0, s.v0, r, g, b, a },
+		{ x+s.x1, y+s.y0, z, s.u1, s.v0, r, g, b, a },
+		{ x+s.x1, y+s.y1, z, s.u1, s.v1, r, g, b, a },
+		{ x+s.x0, y+s.y1, z, s.u0, s.v1, r, g, b, a },
+	};
+	static const int order[6] = { 0, 1, 2, 2, 3, 0 };
+	for (int i=0; i<6; i++)
+		vertices.push_back(corners[order[i]]);
+}
@@ -0,0 +1,54 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include <stdint.h>
+#include <vector>
+
+/* Sprites for the HUD, buttons and bricks. Every sprite is rasterized once
+   at startup into a single RGBA atlas from the same strokes, circles and
+   triangles the old per-part meshes used, and drawn as one textured quad;
+   a SpriteBatch collects the quads of a frame for a single draw. */
+
+enum SpriteId {
+	SPRITE_DIGIT0,			// 7-segment digits 0-9, anchored like the score digits
+	SPRITE_SCORE = SPRITE_DIGIT0 + 10,
+	SPRITE_LEVEL,
+	SPRITE_PAUSE,			// button while playing: black disc with two bars
+	SPRITE_PLAY,			// button while paused: black disc with a triangle
+	SPRITE_RESTART,
+	SPRITE_GAMEOVER,
+	SPRITE_BRICK,			// white, tinted per brick color
+	SPRITE_COUNT
+};
+
+struct Sprite {
+	float x0, y0, x1, y1;	// world extent relative to the anchor
+	float u0, v0, u1, v1;	// atlas texture coordinates
+};
+
+struct SpriteAtlas {
+	int width, height;
+	std::vector<uint8_t> pixels;	// RGBA8, bottom row first
+	Sprite sprites[SPRITE_COUNT];
+};
+
+/* Rasterize every sprite into 'atlas' */
+void buildAtlas (SpriteAtlas &atlas);
+
+struct SpriteVertex {
+	float x, y, z;
+	float u, v;
+	float r, g, b, a;
+};
+
+struct SpriteBatch {
+	std::vector<SpriteVertex> vertices;	// GL_TRIANGLES, 6 per sprite
+
+	/* Queue sprite 'id' anchored at (x,y). Sprites are drawn in the order
+	   they are added; z only decides against the rest of the scene. */
+	void add (const SpriteAtlas &atlas, SpriteId id, float x, float y, float z,
+			float r=1, float g=1, float b=1, float a=1);
+	void clear () { vertices.clear(); }
+};
+
+#endif
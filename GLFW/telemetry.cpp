@@ -0,0 +1,286 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0	// macOS: SIGPIPE is turned off per socket instead
+#endif
+
+using namespace std;
+
+static const char TELEMETRY_MAGIC[4] = { 'S', '2', 'D', 'T' };
+static const uint32_t TELEMETRY_VERSION = 1;
+
+/* Binary records are little-endian and packed at fixed offsets, like captures */
+template <typename T>
+static inline void put (uint8_t *record, size_t offset, T value)
+{
+	memcpy(record + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static inline T get (const uint8_t *record, size_t offset)
+{
+	T value;
+	memcpy(&value, record + offset, sizeof(T));
+	return value;
+}
+
+void telemetryHeader (string &out)
+{
+	out.append(TELEMETRY_MAGIC, 4);
+	out.append((const char*)&TELEMETRY_VERSION, 4);
+}
+
+bool telemetryCheckHeader (const uint8_t *header)
+{
+	return memcmp(header, TELEMETRY_MAGIC, 4) == 0 && get<uint32_t>(header, 4) == TELEMETRY_VERSION;
+}
+
+static const char LINE_FORMAT[] = "t=%lf score=%d level=%d caught=%d missed_red=%d missed_green=%d lasers=%d "
+	"frames=%d dropped=%d frame_p50=%f frame_p95=%f frame_p99=%f frame_max=%f rss_kb=%d";
+
+void telemetryEncode (const TelemetryBatch &b, TelemetryFormat format, string &out)
+{
+	if (format == TELEMETRY_LINE) {
+		char line[320];
+		snprintf(line, sizeof line, "t=%.3f score=%d level=%d caught=%d missed_red=%d missed_green=%d lasers=%d "
+				"frames=%d dropped=%d frame_p50=%.2f frame_p95=%.2f frame_p99=%.2f frame_max=%.2f rss_kb=%d\n",
+				b.time, b.score, b.level, b.caught, b.missed_red, b.missed_green, b.lasers,
+				b.frames, b.dropped, b.frame_ms_p50, b.frame_ms_p95, b.frame_ms_p99, b.frame_ms_max, b.rss_kb);
+		out += line;
+		return;
+	}
+	uint8_t record[TELEMETRY_RECORD_SIZE] = {};
+	put(record, 0, b.time);
+	put(record, 8, b.score); put(record, 12, b.level); put(record, 16, b.caught);
+	put(record, 20, b.missed_red); put(record, 24, b.missed_green); put(record, 28, b.lasers);
+	put(record, 32, b.frames); put(record, 36, b.dropped);
+	put(record, 40, b.frame_ms_p50); put(record, 44, b.frame_ms_p95);
+	put(record, 48, b.frame_ms_p99); put(record, 52, b.frame_ms_max);
+	put(record, 56, b.rss_kb);
+	out.append((const char*)record, sizeof record);
+}
+
+bool telemetryDecodeRecord (const uint8_t *record, TelemetryBatch &b)
+{
+	b.time = get<double>(record, 0);
+	b.score = get<int32_t>(record, 8); b.level = get<int32_t>(record, 12); b.caught = get<int32_t>(record, 16);
+	b.missed_red = get<int32_t>(record, 20); b.missed_green = get<int32_t>(record, 24); b.lasers = get<int32_t>(record, 28);
+	b.frames = get<int32_t>(record, 32); b.dropped = get<int32_t>(record, 36);
+	b.frame_ms_p50 = get<float>(record, 40); b.frame_ms_p95 = get<float>(record, 44);
+	b.frame_ms_p99 = get<float>(record, 48); b.frame_ms_max = get<float>(record, 52);
+	b.rss_kb = get<int32_t>(record, 56);
+	return b.frames >= 0 && b.dropped >= 0;
+}
+
+bool telemetryDecodeLine (const char *line, TelemetryBatch &b)
+{
+	return sscanf(line, LINE_FORMAT, &b.time, &b.score, &b.level, &b.caught, &b.missed_red, &b.missed_green,
+			&b.lasers, &b.frames, &b.dropped, &b.frame_ms_p50, &b.frame_ms_p95, &b.frame_ms_p99,
+			&b.frame_ms_max, &b.rss_kb) == 14;
+}
+
+int32_t telemetryResidentKB ()
+{
+	// Current resident size where /proc has it, else the peak
+	long pages;
+	if (FILE *statm = fopen("/proc/self/statm", "r")) {
+		int fields = fscanf(statm, "%*s %ld", &pages);
+		fclose(statm);
+		if (fields == 1)
+			return pages * (sysconf(_SC_PAGESIZE) / 1024);
+	}
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss / 1024;	// bytes there, KB elsewhere
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+TelemetryStream::TelemetryStream ()
+{
+	head = tail = 0;
+	dropped = 0;
+	socket = false;
+	format = TELEMETRY_LINE;
+	interval = 1;
+	fd = -1;
+	sent = lost = 0;
+	running = quitting = false;
+}
+
+TelemetryStream::~TelemetryStream ()
+{
+	close();
+}
+
+bool TelemetryStream::open (const char *target, TelemetryFormat f, double seconds)
+{
+	close();
+	format = f;
+	interval = seconds;
+	socket = strncmp(target, "unix:", 5) == 0;
+	path = socket ? target + 5 : target;
+	if (!socket) {
+		fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+		if (fd < 0) {
+			fprintf(stderr, "%s: cannot open for telemetry: %s\n", path.c_str(), strerror(errno));
+			return false;
+		}
+		string header;
+		if (format == TELEMETRY_BINARY && lseek(fd, 0, SEEK_END) == 0)
+			telemetryHeader(header);
+		if (!send(header))
+			return false;
+	}
+	// A socket is connected by the writer, so a collector may start later
+	quitting = false;
+	running = true;
+	writer = thread(&TelemetryStream::run, this);
+	return true;
+}
+
+void TelemetryStream::frame (const TelemetryFrame &f)
+{
+	unsigned h = head.load(memory_order_relaxed);
+	if (h - tail.load(memory_order_acquire) == RING) {
+		dropped++;
+		return;
+	}
+	ring[h % RING] = f;
+	head.store(h + 1, memory_order_release);
+}
+
+void TelemetryStream::close ()
+{
+	if (running) {
+		{
+			lock_guard<mutex> hold(lock);
+			quitting = true;
+		}
+		wake.notify_all();
+		writer.join();
+		running = false;
+	}
+	if (fd >= 0)
+		::close(fd);
+	fd = -1;
+}
+
+/* Fold every frame queued since the last batch; false when there were none */
+bool TelemetryStream::drain (TelemetryBatch &b)
+{
+	unsigned h = head.load(memory_order_acquire), t = tail.load(memory_order_relaxed);
+	int lost_frames = dropped.exchange(0);
+	if (h == t && lost_frames == 0)
+		return false;
+	vector<float> times;
+	memset(&b, 0, sizeof b);
+	for (; t != h; t++) {
+		const TelemetryFrame &f = ring[t % RING];
+		times.push_back(f.frame_ms);
+		b.time = f.time;
+		b.score = f.score; b.level = f.level; b.caught = f.caught;
+		b.missed_red = f.missed_red; b.missed_green = f.missed_green; b.lasers = f.lasers;
+	}
+	tail.store(h, memory_order_release);
+
+	b.frames = times.size();
+	b.dropped = lost_frames;
+	if (!times.empty()) {
+		sort(times.begin(), times.end());
+		size_t n = times.size();
+		b.frame_ms_p50 = times[n*50/100];
+		b.frame_ms_p95 = times[min(n-1, n*95/100)];
+		b.frame_ms_p99 = times[min(n-1, n*99/100)];
+		b.frame_ms_max = times[n-1];
+	}
+	b.rss_kb = telemetryResidentKB();
+	return true;
+}
+
+bool TelemetryStream::connect ()
+{
+	struct sockaddr_un address;
+	memset(&address, 0, sizeof address);
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof address.sun_path)
+		return false;
+	strcpy(address.sun_path, path.c_str());
+	fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return false;
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof on);
+#endif
+	if (::connect(fd, (struct sockaddr*)&address, sizeof address) != 0) {
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+	string header;
+	if (format == TELEMETRY_BINARY)
+		telemetryHeader(header);
+	return send(header);
+}
+
+/* Writer thread only, apart from the file header in open() */
+bool TelemetryStream::send (const string &bytes)
+{
+	if (fd < 0 && !(socket && connect()))
+		return false;
+	const char *p = bytes.data();
+	size_t left = bytes.size();
+	while (left > 0) {
+		ssize_t n = socket ? ::send(fd, p, left, MSG_NOSIGNAL) : ::write(fd, p, left);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			// The collector went away: reconnect for the next batch
+			if (socket) {
+				::close(fd);
+				fd = -1;
+			}
+			return false;
+		}
+		p += n;
+		left -= n;
+	}
+	return true;
+}
+
+void TelemetryStream::run ()
+{
+	TelemetryBatch batch;
+	string bytes;
+	for (bool more = true; more; ) {
+		{
+			unique_lock<mutex> hold(lock);
+			wake.wait_for(hold, chrono::duration<double>(interval), [this] { return quitting; });
+			more = !quitting;
+		}
+		if (!drain(batch))
+			continue;
+		bytes.clear();
+		telemetryEncode(batch, format, bytes);
+		if (send(bytes))
+			sent++;
+		else
+			lost++;
+	}
+}
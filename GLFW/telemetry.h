@@ -0,0 +1,97 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+
+/* Game-state telemetry for unattended machines. The game hands one
+   TelemetryFrame per frame to a TelemetryStream without ever waiting:
+   frames go into a fixed ring, and a writer thread folds them into one
+   TelemetryBatch per interval and sends it to a collector's UNIX socket
+   or appends it to a file. */
+
+/* Counters as they stand after one frame */
+struct TelemetryFrame {
+	double time;			// instrumentNow()
+	float frame_ms;			// since the previous frame
+	int32_t score, level;	// level is the index into the mapped levels
+	int32_t caught, missed_red, missed_green, lasers;
+};
+
+/* One interval: the latest counters plus frame-time percentiles and memory */
+struct TelemetryBatch {
+	double time;
+	int32_t score, level, caught, missed_red, missed_green, lasers;
+	int32_t frames;			// frames folded into this batch
+	int32_t dropped;		// frames lost to a full ring since the last batch
+	float frame_ms_p50, frame_ms_p95, frame_ms_p99, frame_ms_max;
+	int32_t rss_kb;			// resident memory when the batch was made
+};
+
+/* Line protocol: one "key=value ..." line per batch, readable with grep.
+   Binary protocol: "S2DT" and a version once per stream, then fixed-size
+   little-endian records. */
+enum TelemetryFormat { TELEMETRY_LINE, TELEMETRY_BINARY };
+
+const size_t TELEMETRY_HEADER_SIZE = 8;
+const size_t TELEMETRY_RECORD_SIZE = 64;
+
+void telemetryHeader (std::string &out);
+void telemetryEncode (const TelemetryBatch &batch, TelemetryFormat format, std::string &out);
+
+/* Parse one binary record or one line (without its newline); false when malformed */
+bool telemetryDecodeRecord (const uint8_t *record, TelemetryBatch &batch);
+bool telemetryDecodeLine (const char *line, TelemetryBatch &batch);
+bool telemetryCheckHeader (const uint8_t *header);
+
+/* Resident set size of this process in KB, 0 when unknown */
+int32_t telemetryResidentKB ();
+
+struct TelemetryStream {
+	TelemetryStream ();
+	~TelemetryStream ();
+
+	/* "unix:PATH" sends to a collector listening there, anything else is a
+	   file to append to. Batches go out every 'interval' seconds. */
+	bool open (const char *target, TelemetryFormat format, double interval);
+	bool active () const { return running; }
+
+	/* Game thread only. Never blocks; counts the frame as dropped instead
+	   when the writer has fallen a whole ring behind */
+	void frame (const TelemetryFrame &f);
+
+	/* Send what is left and join the writer */
+	void close ();
+
+	long batchesSent () const { return sent; }
+	long batchesLost () const { return lost; }
+
+private:
+	static const unsigned RING = 1024;
+	TelemetryFrame ring[RING];
+	std::atomic<unsigned> head, tail;	// head written by the game, tail by the writer
+	std::atomic<int> dropped;
+
+	std::string path;
+	bool socket;
+	TelemetryFormat format;
+	double interval;
+	int fd;
+	long sent, lost;
+
+	std::thread writer;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool running, quitting;
+
+	void run ();
+	bool drain (TelemetryBatch &batch);
+	bool connect ();
+	bool send (const std::string &bytes);
+};
+
+#endif